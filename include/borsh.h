@@ -20,10 +20,25 @@
 #define BORSH_CPP20_H
 
 #include "borsh/concepts.h"
+#include "borsh/flat_map.h"
+#include "borsh/jagged.h"
+#include "borsh/arena.h"
+#include "borsh/reflection.h"
 #include "borsh/utils.h"
 #include "borsh/converters.h"
+#include "borsh/intern.h"
+#include "borsh/segments.h"
+#include "borsh/output.h"
 #include "borsh/serializer.h"
 #include "borsh/templates.h"
+#include "borsh/sequence.h"
+#include "borsh/cached.h"
+#include "borsh/decode_cache.h"
+#include "borsh/delta.h"
+#include "borsh/overlay.h"
+#include "borsh/lazy_vec.h"
+#include "borsh/stream.h"
+#include "borsh/pool.h"
 #include "boost/ut.hpp"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef BORSH_CPP20_ARENA_H
+#define BORSH_CPP20_ARENA_H
+
+#include "concepts.h"
+
+#include <memory>
+#include <memory_resource>
+
+namespace borsh
+{
+
+/**
+ * Bump allocator for the nodes of recursive types. Pass one to `deserialize()` and every `arena_ptr` in the decoded
+ * object is allocated from it instead of with its own `new`.
+ */
+using arena = std::pmr::monotonic_buffer_resource;
+
+/**
+ * Destroys the object but leaves its memory alone, the memory resource it came from reclaims it all at once.
+ */
+struct arena_deleter
+{
+    template <typename T> void operator()(T* pointer) const noexcept { std::destroy_at(pointer); }
+};
+
+/**
+ * A `Box<T>` whose node is allocated from the memory resource handed to the deserializer. The resource must outlive
+ * the pointer.
+ */
+template <typename T> using arena_ptr = std::unique_ptr<T, arena_deleter>;
+
+template <typename T> struct is_box<std::unique_ptr<T, arena_deleter>> : std::true_type
+{
+};
+
+} // namespace borsh
+
+#endif
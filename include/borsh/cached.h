@@ -0,0 +1,223 @@
+#pragma once
+#ifndef BORSH_CPP20_CACHED_H
+#define BORSH_CPP20_CACHED_H
+
+#include "concepts.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace borsh
+{
+
+/**
+ * Objects whose top level fields can be told apart: aggregates, or types with a hand-written serialize() function.
+ */
+template <typename T>
+concept RecordableType = CustomSerializable<T> || AggregateType<T>;
+
+/**
+ * Has `serializer` visit the top level fields of `object`, as the outermost operator() call, so that a recording
+ * serializer sees them one by one.
+ * @tparam T
+ * @param object
+ * @param serializer
+ */
+template <RecordableType T> void visit_top_level_fields(T& object, Serializer& serializer)
+{
+    if constexpr (CustomSerializable<T>)
+    {
+        serialize(object, serializer);
+    }
+    else
+    {
+        visit_fields(object, [&serializer](auto&... members) { serializer(members...); });
+    }
+}
+
+/**
+ * Keeps an object together with its encoding and the offset of each of its fields in it. After changing a few
+ * fields and marking them dirty, `bytes()` re-encodes only those fields: one that keeps its encoded size is patched in
+ * place, one whose size changes is spliced in and the fields after it are shifted, never re-encoded. Updating a large
+ * object then costs about as much as the fields that changed.
+ *
+ * The fields are the ones the object's serialize() function passes to the serializer, or its members if it's an
+ * aggregate without one. That function has to list the same fields every time, regardless of their values.
+ * @tparam T
+ */
+template <RecordableType T> class cached
+{
+public:
+    cached() = default;
+
+    explicit cached(T inValue) : object(std::move(inValue)) {}
+
+    cached(const cached& other) : object(other.object) {}
+
+    cached(cached&& other) noexcept(std::is_nothrow_move_constructible_v<T>) : object(std::move(other.object)) {}
+
+    cached& operator=(const cached& other)
+    {
+        object = other.object;
+        invalidate();
+        return *this;
+    }
+
+    cached& operator=(cached&& other) noexcept(std::is_nothrow_move_assignable_v<T>)
+    {
+        object = std::move(other.object);
+        invalidate();
+        return *this;
+    }
+
+    const T& get() const noexcept { return object; }
+    const T& operator*() const noexcept { return object; }
+    const T* operator->() const noexcept { return &object; }
+
+    /**
+     * Gives write access to a field and marks it dirty.
+     * @param member
+     * @return
+     */
+    template <typename F> F& modify(F T::*member)
+    {
+        F& field = object.*member;
+        mark_dirty(field);
+        return field;
+    }
+
+    /**
+     * Marks the field that `field` is, or lies within the inline bytes of, dirty, for fields that were changed through
+     * `get_mutable()`. Memory a field owns elsewhere, such as the elements of a vector, isn't part of it: pass the field
+     * itself after changing those. Throws `std::invalid_argument` if `field` isn't inside any of the fields of the
+     * object.
+     * @param field
+     */
+    template <typename F> void mark_dirty(const F& field)
+    {
+        if (fields.empty())
+        {
+            // nothing is encoded yet, it all gets encoded anyway
+            return;
+        }
+
+        const auto* address = reinterpret_cast<const uint8_t*>(&field);
+        for (std::size_t i = 0; i < fields.size(); ++i)
+        {
+            const auto* start = static_cast<const uint8_t*>(fields[i].address);
+            if (std::less_equal<>()(start, address) && std::less<>()(address, start + fields[i].size))
+            {
+                dirty[i] = true;
+                anyDirty = true;
+                return;
+            }
+        }
+        throw std::invalid_argument("Not a field of the cached object");
+    }
+
+    /**
+     * Write access to the whole object. Fields changed through it have to be marked dirty, or the next encoding will
+     * miss them.
+     */
+    T& get_mutable() noexcept { return object; }
+
+    /**
+     * Forgets the encoding, the next call to `bytes()` encodes the whole object again.
+     */
+    void invalidate() noexcept
+    {
+        fields.clear();
+        dirty.clear();
+        anyDirty = false;
+    }
+
+    /**
+     * The encoding of the object, brought up to date with the fields marked dirty since the last call.
+     */
+    const std::vector<uint8_t>& bytes()
+    {
+        if (fields.empty())
+        {
+            encodeAll();
+        }
+        else if (anyDirty)
+        {
+            encodeDirty();
+        }
+        return encoding;
+    }
+
+private:
+    T                                      object{};
+    std::vector<uint8_t>                   encoding;
+    std::vector<Serializer::RecordedField> fields;
+    std::vector<bool>                      dirty;
+    std::vector<uint8_t>                   scratch;
+    bool                                   anyDirty = false;
+
+    void encodeAll()
+    {
+        encoding.clear();
+        fields.clear();
+
+        const uint8_t* data = encoding.data();
+        Serializer     serializer(encoding, data, SerializerDirection::Serialize);
+        serializer.recording(fields);
+        visit_top_level_fields(object, serializer);
+
+        dirty.assign(fields.size(), false);
+        anyDirty = false;
+    }
+
+    void encodeDirty()
+    {
+        for (std::size_t i = 0; i < fields.size(); ++i)
+        {
+            if (!dirty[i])
+            {
+                continue;
+            }
+
+            scratch.clear();
+            const uint8_t* data = scratch.data();
+            Serializer     serializer(scratch, data, SerializerDirection::Serialize);
+            fields[i].encode(serializer, fields[i].address);
+
+            const std::size_t offset = fields[i].offset;
+            const std::size_t previousSize = (i + 1 < fields.size() ? fields[i + 1].offset : encoding.size()) - offset;
+            if (scratch.size() == previousSize)
+            {
+                std::memcpy(encoding.data() + offset, scratch.data(), scratch.size());
+            }
+            else
+            {
+                const auto start = encoding.begin() + static_cast<std::ptrdiff_t>(offset);
+                if (scratch.size() > previousSize)
+                {
+                    encoding.insert(start + static_cast<std::ptrdiff_t>(previousSize), scratch.size() - previousSize, 0);
+                }
+                else
+                {
+                    encoding.erase(start + static_cast<std::ptrdiff_t>(scratch.size()), start + static_cast<std::ptrdiff_t>(previousSize));
+                }
+                std::memcpy(encoding.data() + offset, scratch.data(), scratch.size());
+
+                for (std::size_t j = i + 1; j < fields.size(); ++j)
+                {
+                    fields[j].offset = fields[j].offset + scratch.size() - previousSize;
+                }
+            }
+            dirty[i] = false;
+        }
+        anyDirty = false;
+    }
+};
+
+} // namespace borsh
+
+#endif
@@ -16,6 +16,20 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <utility>
+#include <tuple>
+#include <optional>
+#if __has_include(<flat_map>)
+#include <flat_map>
+#endif
+#if __has_include(<flat_set>)
+#include <flat_set>
+#endif
 
 #include "int128.h"
 
@@ -24,6 +38,21 @@ namespace borsh
 
 class Serializer;
 
+/**
+ * Thrown when the input ends before the object being decoded does. `needed()` is the number of bytes, counted from the
+ * start of the input, it takes to decode past the point where it stopped.
+ */
+class incomplete_input : public std::out_of_range
+{
+public:
+    explicit incomplete_input(std::size_t inNeeded) : std::out_of_range("Unexpected end of input"), neededSize(inNeeded) {}
+
+    std::size_t needed() const noexcept { return neededSize; }
+
+private:
+    std::size_t neededSize;
+};
+
 template <typename T>
 #if (defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER))
 concept IntegralType = std::is_integral_v<T> || std::ranges::__detail::__is_int128<T>;
@@ -44,6 +73,9 @@ concept NumericType = IntegralType<T> || FloatType<T>;
 template <typename T>
 concept StringType = std::is_same_v<T, std::string>;
 
+/**
+ * Specialize for a type with its own to_bytes() and from_bytes() functions, whose encoding is `sizeof(T)` bytes long.
+ */
 template <typename T, typename = void> struct IsScalar : std::false_type
 {
 };
@@ -51,10 +83,37 @@ template <typename T, typename = void> struct IsScalar : std::false_type
 template <typename T>
 concept ScalarType = IsScalar<T>::value || NumericType<T> || StringType<T>;
 
+/**
+ * Specialize to opt a type into being encoded and decoded as a single bulk copy of its object representation. Only
+ * do so for trivially copyable types without padding whose fields are little endian integers, in declaration order.
+ */
+template <typename T, typename = void> struct IsTriviallySerializable : std::false_type
+{
+};
+
+/**
+ * Specialize for a type with a hand-written serialize() function that reads every one of its fields, so that
+ * deserializing it can skip zero-initializing the object first.
+ */
+template <typename T, typename = void> struct IsFullyDecoded : std::false_type
+{
+};
+
+/**
+ * Specialize for a type whose encodings vary in size, to have `serialize()` learn how large they tend to get and
+ * reserve that much up front. See `capacity_hint`.
+ */
+template <typename T, typename = void> struct IsCapacityLearned : std::false_type
+{
+};
+
 template <typename T>
-concept is_bounded_array_v = std::rank_v<T> == 1 && std::extent_v<T> != 0;
+concept CapacityLearned = IsCapacityLearned<std::remove_cv_t<T>>::value;
 
-template <typename T> using remove_extent_and_cv_t = std::remove_extent_t<std::remove_cv_t<T>>;
+template <typename T>
+concept is_bounded_array_v = std::rank_v<T> >= 1 && std::extent_v<T> != 0;
+
+template <typename T> using remove_extent_and_cv_t = std::remove_all_extents_t<std::remove_cv_t<T>>;
 
 template <typename T, typename C>
 concept is_same_remove_extent_v = std::is_same_v<remove_extent_and_cv_t<T>, C>;
@@ -116,8 +175,52 @@ concept NonScalarStdArrayType = is_std_array_v<T> && !ScalarType<remove_cv_and_a
 template <typename T>
 concept StdArrayType = ScalarStdArrayType<T> || NonScalarStdArrayType<T>;
 
+/**
+ * The element type at the bottom of a (possibly nested) C-style array or std::array.
+ */
+template <typename T> struct innermost_element
+{
+    using type = T;
+    static constexpr std::size_t count = 1;
+};
+
+template <typename T, std::size_t N> struct innermost_element<T[N]>
+{
+    using type = typename innermost_element<std::remove_cv_t<T>>::type;
+    static constexpr std::size_t count = N * innermost_element<std::remove_cv_t<T>>::count;
+};
+
+template <typename T, std::size_t N> struct innermost_element<std::array<T, N>>
+{
+    using type = typename innermost_element<std::remove_cv_t<T>>::type;
+    static constexpr std::size_t count = N * innermost_element<std::remove_cv_t<T>>::count;
+};
+
+template <typename T> using innermost_element_t = typename innermost_element<std::remove_cv_t<T>>::type;
+
+template <typename T> inline constexpr std::size_t innermost_count_v = innermost_element<std::remove_cv_t<T>>::count;
+
+/**
+ * Fixed size arrays of any rank, including nested std::arrays, whose innermost elements are numbers and which contain
+ * no padding. Their storage is a single contiguous run of scalars, which is also their borsh encoding.
+ */
+template <typename T>
+concept NumericRunType = (is_bounded_array_v<T> || is_std_array_v<std::remove_cv_t<T>>) && NumericType<innermost_element_t<T>>
+    && sizeof(T) == innermost_count_v<T> * sizeof(innermost_element_t<T>);
+
+/**
+ * Plain aggregates without a hand-written serialize() function are serialized field by field, in declaration order,
+ * by discovering their members through structured bindings. Fields that are C-style arrays or types constructible
+ * from anything cannot be counted reliably; such types need a hand-written serialize() function.
+ */
+template <typename T>
+concept AggregateType = std::is_aggregate_v<T> && std::is_class_v<T> && !std::is_union_v<T> && !is_std_array_v<T> && !ScalarType<T>;
+
 template <typename T>
-concept SerializableElement = requires(std::remove_cv_t<T> t, Serializer& s) { serialize(t, s); };
+concept CustomSerializable = requires(std::remove_cv_t<T> t, Serializer& s) { serialize(t, s); };
+
+template <typename T>
+concept SerializableElement = CustomSerializable<T> || AggregateType<std::remove_cv_t<T>>;
 
 template <typename T>
 concept SerializableArray =
@@ -142,7 +245,114 @@ concept SerializableVectorVector = requires(T t) {
 };
 
 template <typename T>
-concept Serializable = SerializableElement<T> || SerializableArray<T> || SerializableStdArray<T> || SerializableVector<T> || SerializableVectorVector<T>;
+struct is_std_map : std::false_type {};
+
+template <typename K, typename V, typename C, typename A>
+struct is_std_map<std::map<K, V, C, A>> : std::true_type {};
+
+template <typename K, typename V, typename H, typename E, typename A>
+struct is_std_map<std::unordered_map<K, V, H, E, A>> : std::true_type {};
+
+#ifdef __cpp_lib_flat_map
+template <typename K, typename V, typename C, typename KC, typename VC>
+struct is_std_map<std::flat_map<K, V, C, KC, VC>> : std::true_type {};
+#endif
+
+/**
+ * Specialized by map types defined outside of the standard library that support in-order appends through
+ * `emplace_hint(end(), key, value)`, such as `borsh::flat_map`.
+ */
+template <typename T>
+struct is_flat_map : std::false_type {};
+
+template <typename T>
+inline constexpr bool is_std_map_v = is_std_map<std::remove_cv_t<T>>::value || is_flat_map<std::remove_cv_t<T>>::value;
+
+template <typename T>
+struct is_std_set : std::false_type {};
+
+template <typename K, typename C, typename A>
+struct is_std_set<std::set<K, C, A>> : std::true_type {};
+
+template <typename K, typename H, typename E, typename A>
+struct is_std_set<std::unordered_set<K, H, E, A>> : std::true_type {};
+
+#ifdef __cpp_lib_flat_set
+template <typename K, typename C, typename KC>
+struct is_std_set<std::flat_set<K, C, KC>> : std::true_type {};
+#endif
+
+template <typename T>
+struct is_flat_set : std::false_type {};
+
+template <typename T>
+inline constexpr bool is_std_set_v = is_std_set<std::remove_cv_t<T>>::value || is_flat_set<std::remove_cv_t<T>>::value;
+
+/**
+ * Ordered containers whose comparator matches the canonical borsh key order can be written out by plain iteration,
+ * everything else has to be sorted first.
+ */
+template <typename T>
+concept NaturallyOrderedType = requires {
+    typename T::key_compare;
+    requires std::is_same_v<typename T::key_compare, std::less<typename T::key_type>> || std::is_same_v<typename T::key_compare, std::less<>>;
+};
+
+template <typename T>
+concept SerializableMap = is_std_map_v<T> && SerializableElement<typename T::key_type> && SerializableElement<typename T::mapped_type>;
+
+template <typename T>
+concept SerializableSet = is_std_set_v<T> && SerializableElement<typename T::key_type>;
+
+/**
+ * Node based containers, whose entries can be detached, decoded into, and linked back without reallocating them.
+ */
+template <typename T>
+concept NodeReusable = requires(T& container) {
+    typename T::node_type;
+    container.extract(container.begin());
+};
+
+template <typename T>
+struct is_optional : std::false_type {};
+
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+concept OptionalType = is_optional<std::remove_cv_t<T>>::value;
+
+/**
+ * Owning pointers that serialize transparently as the object they point to, like Rust's `Box<T>`. Only pointer types
+ * the deserializer knows how to allocate qualify.
+ */
+template <typename T>
+struct is_box : std::false_type {};
+
+template <typename T>
+struct is_box<std::unique_ptr<T>> : std::true_type {};
+
+template <typename T>
+struct is_box<std::shared_ptr<T>> : std::true_type {};
+
+template <typename T>
+concept BoxType = is_box<std::remove_cv_t<T>>::value;
+
+template <typename T>
+struct is_interned : std::false_type {};
+
+template <typename T>
+concept InternedType = is_interned<std::remove_cv_t<T>>::value;
+
+template <typename T>
+struct is_jagged : std::false_type {};
+
+template <typename T>
+concept SerializableJagged = is_jagged<std::remove_cv_t<T>>::value && SerializableElement<typename T::value_type>;
+
+template <typename T>
+concept Serializable = SerializableElement<T> || SerializableArray<T> || SerializableStdArray<T> || SerializableVector<T> || SerializableVectorVector<T>
+    || SerializableMap<T> || SerializableSet<T> || SerializableJagged<T> || OptionalType<T> || BoxType<T> || InternedType<T>;
 
 template <typename T>
 concept SerializableNonScalar = SerializableElement<T> && !ScalarType<T>;
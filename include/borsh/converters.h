@@ -40,19 +40,47 @@ void to_bytes(StringType auto const& value, std::vector<uint8_t>& buffer)
     }
 }
 
-void to_bytes(ScalarArrayType auto const& array, std::vector<uint8_t>& buffer)
+/**
+ * Writes a contiguous run of numbers: floats are checked for NaN up front and on little endian targets the whole run
+ * is appended with a single copy.
+ */
+template <NumericType Element> void append_run(const Element* elements, std::size_t count, std::vector<uint8_t>& buffer)
 {
-    for (auto item : array)
+    if constexpr (FloatType<Element>)
     {
-        to_bytes(item, buffer);
+        if (std::any_of(elements, elements + count, [](Element element) { return std::isnan(element); })) [[unlikely]]
+        {
+            throw std::invalid_argument("NaN is not allowed");
+        }
+    }
+
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        append(buffer, elements, count * sizeof(Element));
+    }
+    else
+    {
+        std::for_each(elements, elements + count, [&buffer](Element element) { to_bytes(element, buffer); });
     }
 }
 
-void to_bytes(ScalarStdArrayType auto const& array, std::vector<uint8_t>& buffer)
+/**
+ * Fixed size arrays of numbers, of any rank, are written as one run.
+ */
+template <typename T>
+    requires ScalarArrayType<T> || ScalarStdArrayType<T> || NumericRunType<T>
+void to_bytes(const T& array, std::vector<uint8_t>& buffer)
 {
-    for (auto item : array)
+    if constexpr (NumericRunType<T>)
     {
-        to_bytes(item, buffer);
+        append_run(reinterpret_cast<const innermost_element_t<T>*>(&array), innermost_count_v<T>, buffer);
+    }
+    else
+    {
+        for (const auto& item : array)
+        {
+            to_bytes(item, buffer);
+        }
     }
 }
 
@@ -60,7 +88,10 @@ template <NumericType T> void from_bytes(T& value, const uint8_t*& buffer)
 {
     static_assert(!std::is_const_v<T>, "T must not be const");
 
-    value = (std::endian::native == std::endian::big) ? byteswap(*reinterpret_cast<const T*>(buffer)) : *reinterpret_cast<const T*>(buffer);
+    // copied out since `buffer` need not be aligned for T
+    T bytes;
+    std::memcpy(&bytes, buffer, sizeof(T));
+    value = (std::endian::native == std::endian::big) ? byteswap(bytes) : bytes;
     buffer += sizeof(T);
 }
 
@@ -68,8 +99,9 @@ template <FloatType T> void from_bytes(T& value, const uint8_t*& buffer)
 {
     static_assert(!std::is_const_v<T>, "T must not be const");
 
-    value = (std::endian::native == std::endian::big) ? int_to_float(byteswap(float_to_int(*reinterpret_cast<const T*>(buffer))))
-                                                      : *reinterpret_cast<const T*>(buffer);
+    T bytes;
+    std::memcpy(&bytes, buffer, sizeof(T));
+    value = (std::endian::native == std::endian::big) ? int_to_float(byteswap(float_to_int(bytes))) : bytes;
     buffer += sizeof(T);
 }
 
@@ -80,31 +112,133 @@ template <StringType T> void from_bytes(T& value, const uint8_t*& buffer)
     const int32_t length = *reinterpret_cast<const int32_t*>(buffer);
     buffer += sizeof(int32_t);
 
-    value.clear();
-    for (int32_t i = 0; i < length; ++i)
+    // assign() keeps the capacity the string already has
+    value.assign(reinterpret_cast<const typename T::value_type*>(buffer), static_cast<std::size_t>(length));
+    buffer += length;
+}
+
+template <NumericType Element> void read_run(Element* elements, std::size_t count, const uint8_t*& buffer)
+{
+    if constexpr (std::is_same_v<Element, bool>)
     {
-        value.push_back(static_cast<typename T::value_type>(*(buffer++)));
+        if (std::any_of(buffer, buffer + count, [](uint8_t byte) { return byte > 1; })) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid bool");
+        }
+    }
+
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        std::memcpy(elements, buffer, count * sizeof(Element));
+        buffer += count * sizeof(Element);
+    }
+    else
+    {
+        std::for_each(elements, elements + count, [&buffer](Element& element) { from_bytes(element, buffer); });
     }
 }
 
-template <ScalarType T, std::size_t N> void from_bytes(T (&value)[N], const uint8_t*& buffer)
+template <typename T>
+    requires ScalarArrayType<T> || ScalarStdArrayType<T> || NumericRunType<T>
+void from_bytes(T& value, const uint8_t*& buffer)
 {
-    static_assert(!std::is_const_v<decltype(value)>, "T must not be const");
+    static_assert(!std::is_const_v<T>, "T must not be const");
 
-    for (auto& element : value)
+    if constexpr (NumericRunType<T>)
     {
-        from_bytes(element, buffer);
+        read_run(reinterpret_cast<innermost_element_t<T>*>(&value), innermost_count_v<T>, buffer);
+    }
+    else
+    {
+        for (auto& element : value)
+        {
+            from_bytes(element, buffer);
+        }
     }
 }
 
-template <typename T, std::size_t N>
-void from_bytes(std::array<T, N>& value, const uint8_t*& buffer)
+/**
+ * Writes a value of fixed wire size to `out`, which must have room for all of it, and advances `out` past it.
+ */
+template <FixedWireSize T> void store(const T& value, uint8_t*& out)
 {
-    static_assert(!std::is_const_v<T>, "T must not be const");
+    if constexpr (IntegralType<T>)
+    {
+        const T littleEndian = (std::endian::native == std::endian::big) ? byteswap(value) : value;
+        std::memcpy(out, &littleEndian, sizeof(T));
+        out += sizeof(T);
+    }
+    else if constexpr (FloatType<T>)
+    {
+        if (std::isnan(value)) [[unlikely]]
+        {
+            throw std::invalid_argument("NaN is not allowed");
+        }
+        store(float_to_int(value), out);
+    }
+    else if constexpr (TriviallySerializable<T>)
+    {
+        std::memcpy(out, &value, sizeof(T));
+        out += sizeof(T);
+    }
+    else if constexpr (std::is_bounded_array_v<T> || is_std_array_v<T>)
+    {
+        for (const auto& item : value)
+        {
+            store(item, out);
+        }
+    }
+    else
+    {
+        visit_fields(const_cast<T&>(value), [&out](const auto&... fields) { (store(fields, out), ...); });
+    }
+}
 
-    for (auto& element : value)
+/**
+ * Reads a value of fixed wire size from `in`, which must hold all of it, and advances `in` past it.
+ */
+template <FixedWireSize T> void load(T& value, const uint8_t*& in)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        // any other byte would make an invalid bool
+        if (*in > 1) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid bool");
+        }
+        value = *in == 1;
+        ++in;
+    }
+    else if constexpr (IntegralType<T>)
+    {
+        std::memcpy(&value, in, sizeof(T));
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            value = byteswap(value);
+        }
+        in += sizeof(T);
+    }
+    else if constexpr (FloatType<T>)
+    {
+        decltype(float_to_int(value)) bits;
+        load(bits, in);
+        value = int_to_float(bits);
+    }
+    else if constexpr (TriviallySerializable<T>)
+    {
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+    }
+    else if constexpr (std::is_bounded_array_v<T> || is_std_array_v<T>)
+    {
+        for (auto& item : value)
+        {
+            load(item, in);
+        }
+    }
+    else
     {
-        from_bytes(element, buffer);
+        visit_fields(value, [&in](auto&... fields) { (load(fields, in), ...); });
     }
 }
 
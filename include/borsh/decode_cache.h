@@ -0,0 +1,133 @@
+#pragma once
+#ifndef BORSH_CPP20_DECODE_CACHE_H
+#define BORSH_CPP20_DECODE_CACHE_H
+
+#include "concepts.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace borsh
+{
+
+/**
+ * A bounded, least recently used cache in front of `deserialize<T>()` for inputs that arrive over and over unchanged.
+ * Inputs are looked up by a hash of their bytes and then compared byte for byte, so a hit returns the object decoded
+ * the first time without decoding anything, and a hash collision is never mistaken for a hit. Objects are handed out
+ * as shared immutable handles that stay valid after they are evicted. Not thread safe.
+ * @tparam T
+ */
+template <Serializable T> class decode_cache
+{
+public:
+    explicit decode_cache(std::size_t inCapacity) : maximumSize(inCapacity)
+    {
+        if (inCapacity == 0)
+        {
+            throw std::invalid_argument("A decode_cache needs room for at least one entry");
+        }
+        index.reserve(inCapacity);
+    }
+
+    /**
+     * Returns the object `input` decodes to, decoding it only if the same bytes haven't been seen recently.
+     * @param input
+     * @return
+     */
+    std::shared_ptr<const T> deserialize(std::span<const uint8_t> input)
+    {
+        const std::size_t hash = hash_bytes(input.data(), input.size());
+
+        if (const auto found = index.find(hash); found != index.end())
+        {
+            auto entry = found->second;
+            if (entry->bytes.size() == input.size() && std::memcmp(entry->bytes.data(), input.data(), input.size()) == 0)
+            {
+                ++hitCount;
+                entries.splice(entries.begin(), entries, entry);
+                return entry->object;
+            }
+
+            // a collision, the entry makes way for the new input
+            index.erase(found);
+            entries.erase(entry);
+        }
+
+        ++missCount;
+        auto object = decode(input);
+
+        if (entries.size() == maximumSize)
+        {
+            // the least recently used entry is recycled, along with the capacity of its bytes
+            index.erase(entries.back().hash);
+            entries.splice(entries.begin(), entries, std::prev(entries.end()));
+        }
+        else
+        {
+            entries.emplace_front();
+        }
+
+        auto& entry = entries.front();
+        entry.hash = hash;
+        entry.bytes.assign(input.begin(), input.end());
+        entry.object = object;
+        index.emplace(hash, entries.begin());
+        return object;
+    }
+
+    std::size_t size() const noexcept { return entries.size(); }
+    std::size_t capacity() const noexcept { return maximumSize; }
+    std::size_t hits() const noexcept { return hitCount; }
+    std::size_t misses() const noexcept { return missCount; }
+
+    void clear() noexcept
+    {
+        index.clear();
+        entries.clear();
+    }
+
+private:
+    struct Entry
+    {
+        std::size_t              hash = 0;
+        std::vector<uint8_t>     bytes;
+        std::shared_ptr<const T> object;
+    };
+
+    using Entries = std::list<Entry>;
+
+    std::size_t                                                 maximumSize;
+    Entries                                                     entries;
+    std::unordered_map<std::size_t, typename Entries::iterator> index;
+    std::size_t                                                 hitCount = 0;
+    std::size_t                                                 missCount = 0;
+
+    static std::shared_ptr<const T> decode(std::span<const uint8_t> input)
+    {
+        std::shared_ptr<T> object;
+#if __cpp_lib_smart_ptr_for_overwrite
+        if constexpr (FullyDecoded<T>)
+        {
+            object = std::make_shared_for_overwrite<T>();
+        }
+        else
+#endif
+        {
+            object = std::make_shared<T>();
+        }
+        deserialize_into(*object, input);
+        return object;
+    }
+};
+
+} // namespace borsh
+
+#endif
@@ -0,0 +1,177 @@
+#pragma once
+#ifndef BORSH_CPP20_DELTA_H
+#define BORSH_CPP20_DELTA_H
+
+#include "concepts.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace borsh
+{
+
+/**
+ * The new encoding of one top level field of an object, replacing `length` bytes at `offset` in the old encoding.
+ */
+struct field_change
+{
+    uint32_t             field;
+    uint32_t             offset;
+    uint32_t             length;
+    std::vector<uint8_t> bytes;
+};
+
+/**
+ * The difference between two encodings of an object, as the top level fields whose bytes changed. A patch is itself
+ * serializable, so it can be shipped instead of the new encoding. It only applies to the exact encoding it was made
+ * from, which is checked by its size and hash.
+ */
+struct patch
+{
+    uint64_t                  base_hash;
+    uint32_t                  base_size;
+    std::vector<field_change> changes;
+};
+
+/**
+ * The offset of every top level field in an encoding of `T`, followed by the offset the encoding ends at.
+ * @tparam T
+ * @param bytes
+ * @return
+ */
+template <RecordableType T> std::vector<std::size_t> field_offsets(std::span<const uint8_t> bytes)
+{
+    std::vector<Serializer::RecordedField> fields;
+
+    decode_new<T>([&](T& object) {
+        const uint8_t* data = bytes.data();
+        Serializer     serializer(data, bytes.data() + bytes.size());
+        serializer.recording(fields);
+        visit_top_level_fields(object, serializer);
+    });
+
+    std::vector<std::size_t> offsets;
+    offsets.reserve(fields.size() + 1);
+    for (const auto& field : fields)
+    {
+        offsets.push_back(field.offset);
+    }
+    offsets.push_back(fields.empty() ? 0 : bytes.size());
+    return offsets;
+}
+
+/**
+ * Compares two encodings of `T` field by field and returns the fields of `newBytes` that differ from `oldBytes`.
+ * Both have to be complete encodings, bytes after the object are treated as part of its last field.
+ * @tparam T
+ * @param oldBytes
+ * @param newBytes
+ * @return
+ */
+template <RecordableType T> patch diff(std::span<const uint8_t> oldBytes, std::span<const uint8_t> newBytes)
+{
+    const auto oldOffsets = field_offsets<T>(oldBytes);
+    const auto newOffsets = field_offsets<T>(newBytes);
+    if (oldOffsets.size() != newOffsets.size()) [[unlikely]]
+    {
+        throw std::invalid_argument("Both encodings need to have the same fields");
+    }
+
+    patch result{ static_cast<uint64_t>(hash_bytes(oldBytes.data(), oldBytes.size())), static_cast<uint32_t>(oldBytes.size()), {} };
+    for (std::size_t i = 0; i + 1 < oldOffsets.size(); ++i)
+    {
+        const auto before = oldBytes.subspan(oldOffsets[i], oldOffsets[i + 1] - oldOffsets[i]);
+        const auto after = newBytes.subspan(newOffsets[i], newOffsets[i + 1] - newOffsets[i]);
+        if (before.size() != after.size() || std::memcmp(before.data(), after.data(), before.size()) != 0)
+        {
+            result.changes.push_back({ static_cast<uint32_t>(i), static_cast<uint32_t>(oldOffsets[i]), static_cast<uint32_t>(before.size()),
+                std::vector<uint8_t>(after.begin(), after.end()) });
+        }
+    }
+    return result;
+}
+
+/**
+ * Turns the encoding a patch was made from into the new encoding. Throws `std::invalid_argument` if `oldBytes` isn't
+ * that encoding.
+ * @param oldBytes
+ * @param changes
+ * @return
+ */
+inline std::vector<uint8_t> apply(std::span<const uint8_t> oldBytes, const patch& changes)
+{
+    if (oldBytes.size() != changes.base_size || hash_bytes(oldBytes.data(), oldBytes.size()) != changes.base_hash) [[unlikely]]
+    {
+        throw std::invalid_argument("The patch was made from different bytes");
+    }
+
+    // every change has to lie within the old bytes, after the one before it, before anything is sized from it
+    std::size_t size = oldBytes.size();
+    std::size_t position = 0;
+    for (const auto& change : changes.changes)
+    {
+        const std::size_t offset = change.offset;
+        const std::size_t length = change.length;
+        if (offset < position || offset > oldBytes.size() || length > oldBytes.size() - offset) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid patch");
+        }
+        size = size - length + change.bytes.size();
+        position = offset + length;
+    }
+
+    std::vector<uint8_t> result;
+    result.reserve(size);
+
+    position = 0;
+    for (const auto& change : changes.changes)
+    {
+        result.insert(result.end(), oldBytes.begin() + position, oldBytes.begin() + change.offset);
+        result.insert(result.end(), change.bytes.begin(), change.bytes.end());
+        position = std::size_t{ change.offset } + change.length;
+    }
+    result.insert(result.end(), oldBytes.begin() + position, oldBytes.end());
+    return result;
+}
+
+/**
+ * Brings an object decoded from the encoding a patch was made from up to date, by decoding only the fields the patch
+ * changes. Throws `std::invalid_argument` if the bytes of a change are not exactly one encoding of its field.
+ * @tparam T
+ * @param object
+ * @param changes
+ */
+template <RecordableType T> void redecode(T& object, const patch& changes)
+{
+    std::vector<Serializer::RecordedField> fields;
+    const uint8_t*                         none = nullptr;
+    Serializer                             recorder(none, none);
+    recorder.recording(fields, false);
+    visit_top_level_fields(object, recorder);
+
+    for (const auto& change : changes.changes)
+    {
+        if (change.field >= fields.size() || fields[change.field].decode == nullptr) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid patch");
+        }
+
+        const uint8_t* data = change.bytes.data();
+        const uint8_t* end = change.bytes.data() + change.bytes.size();
+        Serializer     serializer(data, end);
+        fields[change.field].decode(serializer, const_cast<void*>(fields[change.field].address));
+        // the bytes of a change are the new encoding of its field and nothing else
+        if (data != end) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid patch");
+        }
+    }
+}
+
+} // namespace borsh
+
+#endif
@@ -0,0 +1,421 @@
+#pragma once
+#ifndef BORSH_CPP20_FLAT_MAP_H
+#define BORSH_CPP20_FLAT_MAP_H
+
+#include "concepts.h"
+
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace borsh
+{
+
+/**
+ * An ordered map that keeps its keys and values in two sorted, contiguous vectors. Borsh delivers map entries in
+ * ascending key order, so decoding into a flat_map only ever appends to the back of both vectors, and lookups on the
+ * decoded result are binary searches over a single array of keys. Inserting out of order is supported, but shifts
+ * every entry after the insertion point.
+ * @tparam K
+ * @tparam V
+ * @tparam Compare
+ */
+template <typename K, typename V, typename Compare = std::less<K>> class flat_map
+{
+    template <bool IsConst> class basic_iterator;
+
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const K&, V&>;
+    using const_reference = std::pair<const K&, const V&>;
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    flat_map() = default;
+
+    explicit flat_map(const Compare& inCompare) : compare(inCompare)
+    {
+    }
+
+    template <std::input_iterator It> flat_map(It first, It last, const Compare& inCompare = Compare()) : compare(inCompare)
+    {
+        for (; first != last; ++first)
+        {
+            const auto& [key, mapped] = *first;
+            emplace(key, mapped);
+        }
+    }
+
+    flat_map(std::initializer_list<value_type> entries, const Compare& inCompare = Compare())
+        : flat_map(entries.begin(), entries.end(), inCompare)
+    {
+    }
+
+    iterator       begin() noexcept { return iterator(this, 0); }
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    iterator       end() noexcept { return iterator(this, size()); }
+    const_iterator end() const noexcept { return const_iterator(this, size()); }
+    const_iterator cend() const noexcept { return end(); }
+
+    [[nodiscard]] bool empty() const noexcept { return sortedKeys.empty(); }
+    size_type          size() const noexcept { return sortedKeys.size(); }
+    key_compare        key_comp() const { return compare; }
+
+    const std::vector<K>& keys() const noexcept { return sortedKeys; }
+    const std::vector<V>& values() const noexcept { return mappedValues; }
+
+    void reserve(size_type capacity)
+    {
+        sortedKeys.reserve(capacity);
+        mappedValues.reserve(capacity);
+    }
+
+    void clear() noexcept
+    {
+        sortedKeys.clear();
+        mappedValues.clear();
+    }
+
+    iterator lower_bound(const K& key) { return iterator(this, lowerBoundIndex(key)); }
+
+    const_iterator lower_bound(const K& key) const { return const_iterator(this, lowerBoundIndex(key)); }
+
+    iterator find(const K& key) { return iterator(this, findIndex(key)); }
+
+    const_iterator find(const K& key) const { return const_iterator(this, findIndex(key)); }
+
+    bool contains(const K& key) const { return findIndex(key) != size(); }
+
+    size_type count(const K& key) const { return contains(key) ? 1 : 0; }
+
+    V& at(const K& key)
+    {
+        const auto index = findIndex(key);
+        if (index == size())
+        {
+            throw std::out_of_range("borsh::flat_map::at");
+        }
+        return mappedValues[index];
+    }
+
+    const V& at(const K& key) const
+    {
+        const auto index = findIndex(key);
+        if (index == size())
+        {
+            throw std::out_of_range("borsh::flat_map::at");
+        }
+        return mappedValues[index];
+    }
+
+    V& operator[](const K& key) { return (*emplace(key).first).second; }
+
+    template <typename KeyArg, typename... Args> std::pair<iterator, bool> emplace(KeyArg&& keyArg, Args&&... args)
+    {
+        K          key(std::forward<KeyArg>(keyArg));
+        const auto index = lowerBoundIndex(key);
+        if (index != size() && !compare(key, sortedKeys[index]))
+        {
+            return { iterator(this, index), false };
+        }
+
+        insertAt(index, std::move(key), std::forward<Args>(args)...);
+        return { iterator(this, index), true };
+    }
+
+    std::pair<iterator, bool> insert(const value_type& entry) { return emplace(entry.first, entry.second); }
+
+    std::pair<iterator, bool> insert(value_type&& entry) { return emplace(std::move(entry.first), std::move(entry.second)); }
+
+    /**
+     * Appending in ascending key order through `emplace_hint(end(), ...)` is O(1) amortized, which is how the
+     * deserializer fills the map. Any other position falls back to a regular sorted insert.
+     */
+    template <typename KeyArg, typename... Args> iterator emplace_hint(const_iterator hint, KeyArg&& keyArg, Args&&... args)
+    {
+        if (hint == cend() && (empty() || compare(sortedKeys.back(), keyArg)))
+        {
+            insertAt(size(), K(std::forward<KeyArg>(keyArg)), std::forward<Args>(args)...);
+            return iterator(this, size() - 1);
+        }
+
+        return emplace(std::forward<KeyArg>(keyArg), std::forward<Args>(args)...).first;
+    }
+
+    iterator erase(const_iterator position)
+    {
+        const auto index = static_cast<difference_type>(position.index);
+        sortedKeys.erase(sortedKeys.begin() + index);
+        mappedValues.erase(mappedValues.begin() + index);
+        return iterator(this, position.index);
+    }
+
+    size_type erase(const K& key)
+    {
+        const auto position = find(key);
+        if (position == end())
+        {
+            return 0;
+        }
+
+        erase(position);
+        return 1;
+    }
+
+    friend bool operator==(const flat_map& a, const flat_map& b)
+    {
+        return a.sortedKeys == b.sortedKeys && a.mappedValues == b.mappedValues;
+    }
+
+private:
+    std::vector<K> sortedKeys;
+    std::vector<V> mappedValues;
+    Compare        compare;
+
+    size_type lowerBoundIndex(const K& key) const
+    {
+        return static_cast<size_type>(std::lower_bound(sortedKeys.begin(), sortedKeys.end(), key, compare) - sortedKeys.begin());
+    }
+
+    size_type findIndex(const K& key) const
+    {
+        const auto index = lowerBoundIndex(key);
+        return (index != size() && !compare(key, sortedKeys[index])) ? index : size();
+    }
+
+    template <typename... Args> void insertAt(size_type index, K&& key, Args&&... args)
+    {
+        const auto offset = static_cast<difference_type>(index);
+        sortedKeys.insert(sortedKeys.begin() + offset, std::move(key));
+        try
+        {
+            mappedValues.insert(mappedValues.begin() + offset, V(std::forward<Args>(args)...));
+        }
+        catch (...)
+        {
+            sortedKeys.erase(sortedKeys.begin() + offset);
+            throw;
+        }
+    }
+
+    template <bool IsConst> class basic_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::pair<K, V>;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<IsConst, flat_map::const_reference, flat_map::reference>;
+
+        struct pointer
+        {
+            reference  entry;
+            reference* operator->() noexcept { return &entry; }
+        };
+
+        basic_iterator() = default;
+
+        template <bool OtherConst>
+            requires(IsConst && !OtherConst)
+        // NOLINTNEXTLINE(google-explicit-constructor)
+        basic_iterator(const basic_iterator<OtherConst>& other) noexcept : map(other.map), index(other.index)
+        {
+        }
+
+        reference operator*() const { return { map->sortedKeys[index], map->mappedValues[index] }; }
+        pointer   operator->() const { return { **this }; }
+        reference operator[](difference_type offset) const { return *(*this + offset); }
+
+        basic_iterator& operator++() noexcept
+        {
+            ++index;
+            return *this;
+        }
+
+        basic_iterator operator++(int) noexcept
+        {
+            auto copy = *this;
+            ++index;
+            return copy;
+        }
+
+        basic_iterator& operator--() noexcept
+        {
+            --index;
+            return *this;
+        }
+
+        basic_iterator operator--(int) noexcept
+        {
+            auto copy = *this;
+            --index;
+            return copy;
+        }
+
+        basic_iterator& operator+=(difference_type offset) noexcept
+        {
+            index = static_cast<size_type>(static_cast<difference_type>(index) + offset);
+            return *this;
+        }
+
+        basic_iterator& operator-=(difference_type offset) noexcept { return *this += -offset; }
+
+        friend basic_iterator operator+(basic_iterator it, difference_type offset) noexcept { return it += offset; }
+        friend basic_iterator operator+(difference_type offset, basic_iterator it) noexcept { return it += offset; }
+        friend basic_iterator operator-(basic_iterator it, difference_type offset) noexcept { return it -= offset; }
+
+        friend difference_type operator-(const basic_iterator& a, const basic_iterator& b) noexcept
+        {
+            return static_cast<difference_type>(a.index) - static_cast<difference_type>(b.index);
+        }
+
+        friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept { return a.index == b.index; }
+        friend auto operator<=>(const basic_iterator& a, const basic_iterator& b) noexcept { return a.index <=> b.index; }
+
+    private:
+        friend class flat_map;
+        friend class basic_iterator<!IsConst>;
+
+        using Map = std::conditional_t<IsConst, const flat_map, flat_map>;
+
+        Map*      map = nullptr;
+        size_type index = 0;
+
+        basic_iterator(Map* inMap, size_type inIndex) noexcept : map(inMap), index(inIndex)
+        {
+        }
+    };
+};
+
+/**
+ * An ordered set backed by a single sorted vector, the set counterpart of `flat_map`.
+ * @tparam K
+ * @tparam Compare
+ */
+template <typename K, typename Compare = std::less<K>> class flat_set
+{
+public:
+    using key_type = K;
+    using value_type = K;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator = typename std::vector<K>::const_iterator;
+    using const_iterator = typename std::vector<K>::const_iterator;
+
+    flat_set() = default;
+
+    explicit flat_set(const Compare& inCompare) : compare(inCompare)
+    {
+    }
+
+    template <std::input_iterator It> flat_set(It first, It last, const Compare& inCompare = Compare()) : compare(inCompare)
+    {
+        for (; first != last; ++first)
+        {
+            emplace(*first);
+        }
+    }
+
+    flat_set(std::initializer_list<K> keys, const Compare& inCompare = Compare()) : flat_set(keys.begin(), keys.end(), inCompare)
+    {
+    }
+
+    const_iterator begin() const noexcept { return sortedKeys.begin(); }
+    const_iterator cbegin() const noexcept { return sortedKeys.begin(); }
+    const_iterator end() const noexcept { return sortedKeys.end(); }
+    const_iterator cend() const noexcept { return sortedKeys.end(); }
+
+    [[nodiscard]] bool    empty() const noexcept { return sortedKeys.empty(); }
+    size_type             size() const noexcept { return sortedKeys.size(); }
+    key_compare           key_comp() const { return compare; }
+    const std::vector<K>& keys() const noexcept { return sortedKeys; }
+
+    void reserve(size_type capacity) { sortedKeys.reserve(capacity); }
+    void clear() noexcept { sortedKeys.clear(); }
+
+    const_iterator lower_bound(const K& key) const { return std::lower_bound(sortedKeys.begin(), sortedKeys.end(), key, compare); }
+
+    const_iterator find(const K& key) const
+    {
+        const auto position = lower_bound(key);
+        return (position != end() && !compare(key, *position)) ? position : end();
+    }
+
+    bool      contains(const K& key) const { return find(key) != end(); }
+    size_type count(const K& key) const { return contains(key) ? 1 : 0; }
+
+    template <typename... Args> std::pair<iterator, bool> emplace(Args&&... args)
+    {
+        K          key(std::forward<Args>(args)...);
+        const auto position = lower_bound(key);
+        if (position != end() && !compare(key, *position))
+        {
+            return { position, false };
+        }
+
+        return { sortedKeys.insert(position, std::move(key)), true };
+    }
+
+    std::pair<iterator, bool> insert(const K& key) { return emplace(key); }
+    std::pair<iterator, bool> insert(K&& key) { return emplace(std::move(key)); }
+
+    /**
+     * Appending in ascending order through `emplace_hint(end(), ...)` is O(1) amortized.
+     */
+    template <typename... Args> iterator emplace_hint(const_iterator hint, Args&&... args)
+    {
+        K key(std::forward<Args>(args)...);
+        if (hint == end() && (empty() || compare(sortedKeys.back(), key)))
+        {
+            sortedKeys.push_back(std::move(key));
+            return std::prev(sortedKeys.cend());
+        }
+
+        return emplace(std::move(key)).first;
+    }
+
+    iterator erase(const_iterator position) { return sortedKeys.erase(position); }
+
+    size_type erase(const K& key)
+    {
+        const auto position = find(key);
+        if (position == end())
+        {
+            return 0;
+        }
+
+        sortedKeys.erase(position);
+        return 1;
+    }
+
+    friend bool operator==(const flat_set& a, const flat_set& b) { return a.sortedKeys == b.sortedKeys; }
+
+private:
+    std::vector<K> sortedKeys;
+    Compare        compare;
+};
+
+template <typename K, typename V, typename Compare> struct is_flat_map<flat_map<K, V, Compare>> : std::true_type
+{
+};
+
+template <typename K, typename Compare> struct is_flat_set<flat_set<K, Compare>> : std::true_type
+{
+};
+
+} // namespace borsh
+
+#endif
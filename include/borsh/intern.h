@@ -0,0 +1,192 @@
+#pragma once
+#ifndef BORSH_CPP20_INTERN_H
+#define BORSH_CPP20_INTERN_H
+
+#include "concepts.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+namespace borsh
+{
+
+/**
+ * Values that can be interned: strings and fixed size byte arrays such as keys and hashes.
+ */
+template <typename T>
+concept Internable = StringType<T> || (is_std_array_v<T> && std::is_same_v<typename T::value_type, uint8_t>);
+
+/**
+ * A handle to the one canonical copy of a value kept by an `intern_pool`. It's serialized exactly like the value it
+ * refers to, and decoding it looks the bytes up in the pool, so a value that repeats across a snapshot is only ever
+ * stored once. A default constructed handle refers to an empty value. Handles must not outlive their pool.
+ * @tparam T `std::string` or `std::array<uint8_t, N>`
+ */
+template <Internable T> class interned
+{
+public:
+    using value_type = T;
+
+    interned() noexcept : value(&empty()) {}
+
+    const T& get() const noexcept { return *value; }
+    const T& operator*() const noexcept { return *value; }
+    const T* operator->() const noexcept { return value; }
+
+    friend bool operator==(const interned& a, const interned& b) noexcept { return a.value == b.value || *a.value == *b.value; }
+    friend bool operator==(const interned& a, const T& b) noexcept { return *a.value == b; }
+
+private:
+    friend class intern_pool;
+
+    const T* value;
+
+    explicit interned(const T* inValue) noexcept : value(inValue) {}
+
+    static const T& empty() noexcept
+    {
+        static const T emptyValue{};
+        return emptyValue;
+    }
+};
+
+/**
+ * Owns the canonical copies of interned values. Pass one to `deserialize()` and every `interned<T>` field decoded with
+ * it shares storage with every other field of the same value. A value is looked up by hashing its encoded bytes right
+ * in the input buffer, memory is only allocated the first time a value is seen.
+ */
+class intern_pool
+{
+public:
+    intern_pool() = default;
+    intern_pool(const intern_pool&) = delete;
+    intern_pool& operator=(const intern_pool&) = delete;
+    intern_pool(intern_pool&&) noexcept = default;
+    intern_pool& operator=(intern_pool&&) noexcept = default;
+
+    template <Internable T> interned<T> intern(const T& value)
+    {
+        return intern<T>(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+    }
+
+    /**
+     * Returns the canonical copy of the value whose contents are `bytes`, adding it to the pool if it's new.
+     */
+    template <Internable T> interned<T> intern(std::span<const uint8_t> bytes)
+    {
+        auto& values = table<T>().values;
+        if (const auto found = values.find(bytes); found != values.end())
+        {
+            return interned<T>(&*found);
+        }
+
+        T value;
+        if constexpr (StringType<T>)
+        {
+            value.assign(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        }
+        else
+        {
+            if (bytes.size() != value.size()) [[unlikely]]
+            {
+                throw std::invalid_argument("Cannot intern a byte array of the wrong size");
+            }
+            std::memcpy(value.data(), bytes.data(), bytes.size());
+        }
+        return interned<T>(&*values.insert(std::move(value)).first);
+    }
+
+    /**
+     * Number of distinct values of type `T` in the pool.
+     */
+    template <Internable T> std::size_t size() const noexcept
+    {
+        const auto index = type_index<T>();
+        return index < tables.size() && tables[index] ? static_cast<const table_of<T>&>(*tables[index]).values.size() : 0;
+    }
+
+private:
+    struct bytes_hash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::span<const uint8_t> bytes) const noexcept { return hash_bytes(bytes.data(), bytes.size()); }
+
+        template <Internable T> std::size_t operator()(const T& value) const noexcept { return hash_bytes(value.data(), value.size()); }
+    };
+
+    struct bytes_equal
+    {
+        using is_transparent = void;
+
+        static std::span<const uint8_t> bytes(std::span<const uint8_t> value) noexcept { return value; }
+
+        template <Internable T> static std::span<const uint8_t> bytes(const T& value) noexcept
+        {
+            return { reinterpret_cast<const uint8_t*>(value.data()), value.size() };
+        }
+
+        template <typename A, typename B> bool operator()(const A& a, const B& b) const noexcept
+        {
+            const auto left = bytes(a);
+            const auto right = bytes(b);
+            return left.size() == right.size() && std::memcmp(left.data(), right.data(), left.size()) == 0;
+        }
+    };
+
+    struct table_base
+    {
+        virtual ~table_base() = default;
+    };
+
+    // node based, so the canonical copies never move
+    template <Internable T> struct table_of : table_base
+    {
+        std::unordered_set<T, bytes_hash, bytes_equal> values;
+    };
+
+    std::vector<std::unique_ptr<table_base>> tables;
+
+    static std::size_t next_type_index() noexcept
+    {
+        static std::atomic<std::size_t> count{ 0 };
+        return count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <Internable T> static std::size_t type_index() noexcept
+    {
+        static const std::size_t index = next_type_index();
+        return index;
+    }
+
+    template <Internable T> table_of<T>& table()
+    {
+        const auto index = type_index<T>();
+        if (index >= tables.size()) [[unlikely]]
+        {
+            tables.resize(index + 1);
+        }
+        if (!tables[index]) [[unlikely]]
+        {
+            tables[index] = std::make_unique<table_of<T>>();
+        }
+        return static_cast<table_of<T>&>(*tables[index]);
+    }
+};
+
+template <typename T> struct is_interned<interned<T>> : std::true_type
+{
+};
+
+} // namespace borsh
+
+#endif
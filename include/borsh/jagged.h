@@ -0,0 +1,190 @@
+#pragma once
+#ifndef BORSH_CPP20_JAGGED_H
+#define BORSH_CPP20_JAGGED_H
+
+#include "concepts.h"
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace borsh
+{
+
+/**
+ * A vector of vectors stored in compressed sparse row layout: all elements live in one contiguous vector and a second
+ * vector holds the offset at which every row starts. It has the same wire format as `std::vector<std::vector<T>>`,
+ * but decoding it costs two allocations in total instead of one per inner vector, and walking it never chases
+ * pointers.
+ * @tparam T
+ */
+template <typename T> class jagged
+{
+    static_assert(!std::is_same_v<T, bool>, "std::vector<bool> is not contiguous, use uint8_t instead");
+
+    template <bool IsConst> class basic_iterator;
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using row_type = std::span<T>;
+    using const_row_type = std::span<const T>;
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    jagged() = default;
+
+    jagged(std::initializer_list<std::initializer_list<T>> rows)
+    {
+        for (const auto& row : rows)
+        {
+            push_back(row);
+        }
+    }
+
+    /**
+     * Number of rows.
+     */
+    size_type size() const noexcept { return rowOffsets.size() - 1; }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+    row_type operator[](size_type row) noexcept { return { elements.data() + rowOffsets[row], rowOffsets[row + 1] - rowOffsets[row] }; }
+
+    const_row_type operator[](size_type row) const noexcept
+    {
+        return { elements.data() + rowOffsets[row], rowOffsets[row + 1] - rowOffsets[row] };
+    }
+
+    row_type at(size_type row)
+    {
+        if (row >= size())
+        {
+            throw std::out_of_range("borsh::jagged::at");
+        }
+        return (*this)[row];
+    }
+
+    const_row_type at(size_type row) const
+    {
+        if (row >= size())
+        {
+            throw std::out_of_range("borsh::jagged::at");
+        }
+        return (*this)[row];
+    }
+
+    iterator       begin() noexcept { return iterator(this, 0); }
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    iterator       end() noexcept { return iterator(this, size()); }
+    const_iterator end() const noexcept { return const_iterator(this, size()); }
+
+    /**
+     * All elements of all rows, back to back.
+     */
+    const std::vector<T>& values() const noexcept { return elements; }
+
+    /**
+     * `size() + 1` offsets into `values()`, row `i` spans `[offsets()[i], offsets()[i + 1])`.
+     */
+    const std::vector<size_type>& offsets() const noexcept { return rowOffsets; }
+
+    void reserve(size_type rows, size_type values)
+    {
+        rowOffsets.reserve(rows + 1);
+        elements.reserve(values);
+    }
+
+    void clear() noexcept
+    {
+        elements.clear();
+        rowOffsets.resize(1);
+    }
+
+    /**
+     * Appends a row of `length` value-initialized elements and returns it so it can be filled in place.
+     */
+    row_type add_row(size_type length)
+    {
+        const size_type offset = elements.size();
+        elements.resize(offset + length);
+        rowOffsets.push_back(offset + length);
+        return { elements.data() + offset, length };
+    }
+
+    template <std::ranges::input_range R> void push_back(const R& row)
+    {
+        elements.insert(elements.end(), std::ranges::begin(row), std::ranges::end(row));
+        rowOffsets.push_back(elements.size());
+    }
+
+    void push_back(std::initializer_list<T> row) { push_back(std::span<const T>(row.begin(), row.size())); }
+
+    /**
+     * Removes the last row, there has to be one.
+     */
+    void pop_back()
+    {
+        rowOffsets.pop_back();
+        elements.resize(rowOffsets.back());
+    }
+
+    friend bool operator==(const jagged& a, const jagged& b) { return a.rowOffsets == b.rowOffsets && a.elements == b.elements; }
+
+private:
+    std::vector<T>         elements;
+    std::vector<size_type> rowOffsets{ 0 };
+
+    template <bool IsConst> class basic_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::conditional_t<IsConst, const_row_type, row_type>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+
+        basic_iterator() = default;
+
+        value_type operator*() const { return (*owner)[row]; }
+
+        basic_iterator& operator++() noexcept
+        {
+            ++row;
+            return *this;
+        }
+
+        basic_iterator operator++(int) noexcept
+        {
+            auto copy = *this;
+            ++row;
+            return copy;
+        }
+
+        friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept { return a.row == b.row; }
+
+    private:
+        friend class jagged;
+
+        using Owner = std::conditional_t<IsConst, const jagged, jagged>;
+
+        Owner*    owner = nullptr;
+        size_type row = 0;
+
+        basic_iterator(Owner* inOwner, size_type inRow) noexcept : owner(inOwner), row(inRow)
+        {
+        }
+    };
+};
+
+template <typename T> struct is_jagged<jagged<T>> : std::true_type
+{
+};
+
+} // namespace borsh
+
+#endif
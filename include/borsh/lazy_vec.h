@@ -0,0 +1,202 @@
+#pragma once
+#ifndef BORSH_CPP20_LAZY_VEC_H
+#define BORSH_CPP20_LAZY_VEC_H
+
+#include "concepts.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace borsh
+{
+
+/**
+ * A view of a serialized `std::vector<T>` that decodes elements only when they are indexed or iterated over. Elements
+ * of a fixed wire size are found in constant time. For elements of variable size, the offset of every `stride`th
+ * element is remembered the first time it's passed, so indexing costs at most `stride` element skips once the index
+ * reaches that far. The view doesn't own the bytes, and isn't thread safe since indexing extends the skip index.
+ * @tparam T
+ */
+template <Serializable T> class lazy_vec
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    /**
+     * Offsets of variable size elements are remembered every this many elements.
+     */
+    static constexpr size_type stride = 16;
+
+    /**
+     * Views the vector `input` starts with. Throws `std::out_of_range` if `input` is too short for its length, or for
+     * its elements when they have a fixed size.
+     * @param input
+     */
+    explicit lazy_vec(std::span<const uint8_t> input) : bytes(input)
+    {
+        int32_t length = 0;
+        deserialize_into(length, bytes);
+        if (length < 0) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid length");
+        }
+        count = static_cast<size_type>(length);
+
+        if constexpr (FixedWireSize<T>)
+        {
+            if (elementSize() != 0 && (bytes.size() - sizeof(length)) / elementSize() < count) [[unlikely]]
+            {
+                throw std::out_of_range("Unexpected end of input");
+            }
+        }
+        else
+        {
+            checkpoints.push_back(sizeof(length));
+        }
+    }
+
+    size_type size() const noexcept { return count; }
+
+    [[nodiscard]] bool empty() const noexcept { return count == 0; }
+
+    /**
+     * Decodes the element at `index`, which has to be less than `size()`.
+     */
+    T operator[](size_type index) const
+    {
+        T element{};
+        deserialize_into(element, bytes.subspan(offsetOf(index)));
+        return element;
+    }
+
+    T at(size_type index) const
+    {
+        if (index >= count)
+        {
+            throw std::out_of_range("borsh::lazy_vec::at");
+        }
+        return (*this)[index];
+    }
+
+    T front() const { return at(0); }
+
+    /**
+     * Decodes the elements one after the other, each into the same object.
+     */
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        const T& operator*() const noexcept { return current; }
+        const T* operator->() const noexcept { return &current; }
+
+        iterator& operator++()
+        {
+            ++index;
+            decodeCurrent();
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept { return it.index >= it.count; }
+
+    private:
+        friend class lazy_vec;
+
+        const lazy_vec* view = nullptr;
+        size_type       index = 0;
+        size_type       count = 0;
+        size_type       offset = 0;
+        T               current{};
+
+        iterator(const lazy_vec* inView, size_type inIndex) : view(inView), index(inIndex), count(inView->count), offset(inView->offsetOf(inIndex))
+        {
+            decodeCurrent();
+        }
+
+        void decodeCurrent()
+        {
+            if (index < count)
+            {
+                if constexpr (FixedWireSize<T>)
+                {
+                    offset = view->offsetOf(index);
+                    deserialize_into(current, view->bytes.subspan(offset));
+                }
+                else
+                {
+                    offset += deserialize_into(current, view->bytes.subspan(offset));
+                }
+            }
+        }
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+
+    /**
+     * Iterates from the element at `index` on.
+     */
+    iterator begin_at(size_type index) const { return iterator(this, std::min(index, count)); }
+
+    std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+private:
+    std::span<const uint8_t>         bytes;
+    size_type                        count = 0;
+    mutable std::vector<std::size_t> checkpoints;
+    mutable T                        skipped{};
+
+    static constexpr std::size_t elementSize() noexcept
+    {
+        if constexpr (FixedWireSize<T>)
+        {
+            return wire_size<T>();
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    /**
+     * Where the element at `index` starts, or the end of the vector for `index == size()`.
+     */
+    std::size_t offsetOf(size_type index) const
+    {
+        if constexpr (FixedWireSize<T>)
+        {
+            return sizeof(int32_t) + index * elementSize();
+        }
+        else
+        {
+            size_type   checkpoint = std::min(index / stride, checkpoints.size() - 1);
+            std::size_t offset = checkpoints[checkpoint];
+            for (size_type current = checkpoint * stride; current < index; ++current)
+            {
+                // an element has to be decoded to know how many bytes it takes up
+                offset += deserialize_into(skipped, bytes.subspan(offset));
+                if ((current + 1) % stride == 0 && (current + 1) / stride == checkpoints.size())
+                {
+                    checkpoints.push_back(offset);
+                }
+            }
+            return offset;
+        }
+    }
+};
+
+} // namespace borsh
+
+#endif
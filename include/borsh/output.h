@@ -0,0 +1,522 @@
+#pragma once
+#ifndef BORSH_CPP20_OUTPUT_H
+#define BORSH_CPP20_OUTPUT_H
+
+#include "concepts.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/uio.h>)
+#include <cerrno>
+#include <system_error>
+#include <sys/uio.h>
+#endif
+
+namespace borsh
+{
+
+/**
+ * Somewhere to serialize to other than a `std::vector<uint8_t>`. Bytes are copied into the block between `cursor` and
+ * `limit` inline, and only once it is full does the virtual `overflow()` get called to move on to another one.
+ */
+class sink
+{
+public:
+    virtual ~sink() = default;
+
+    void write(const void* data, std::size_t size)
+    {
+        if (static_cast<std::size_t>(limit - cursor) >= size) [[likely]]
+        {
+            if (size > 0)
+            {
+                std::memcpy(cursor, data, size);
+                cursor += size;
+            }
+        }
+        else
+        {
+            writeAcrossBlocks(static_cast<const uint8_t*>(data), size);
+        }
+    }
+
+    /**
+     * Writes bytes that are part of the object being serialized, such as the contents of a string or a byte vector.
+     * Runs of at least `borrowThreshold` bytes are handed to `borrow()`, which may refer to them instead of copying.
+     * @param data
+     * @param size
+     */
+    void write_borrowed(const void* data, std::size_t size)
+    {
+        if (size >= borrowThreshold) [[unlikely]]
+        {
+            borrow(data, size);
+        }
+        else
+        {
+            write(data, size);
+        }
+    }
+
+    /**
+     * Number of bytes written so far.
+     */
+    std::size_t size() const noexcept { return before + static_cast<std::size_t>(cursor - start); }
+
+protected:
+    uint8_t* start = nullptr;
+    uint8_t* cursor = nullptr;
+    uint8_t* limit = nullptr;
+    // how many bytes were written before `start`
+    std::size_t before = 0;
+    std::size_t borrowThreshold = SIZE_MAX;
+
+    sink() = default;
+    sink(const sink&) = default;
+    sink& operator=(const sink&) = default;
+
+    /**
+     * Called once the block is full, has to point `start`, `cursor` and `limit` at a new block with room for at least
+     * one byte.
+     */
+    virtual void overflow() = 0;
+
+    virtual void borrow(const void* data, std::size_t size) { write(data, size); }
+
+private:
+    void writeAcrossBlocks(const uint8_t* data, std::size_t size)
+    {
+        while (size > 0)
+        {
+            if (cursor == limit)
+            {
+                before += static_cast<std::size_t>(cursor - start);
+                overflow();
+            }
+            const std::size_t count = std::min(size, static_cast<std::size_t>(limit - cursor));
+            std::memcpy(cursor, data, count);
+            cursor += count;
+            data += count;
+            size -= count;
+        }
+    }
+};
+
+#if __has_include(<sys/uio.h>)
+/**
+ * Writes `parts` to the file descriptor `fd` one after the other, gathered into as few `writev()` calls as it takes.
+ * Throws `std::system_error` if writing fails or stops making progress.
+ * @param fd
+ * @param parts
+ * @return The number of bytes written
+ */
+inline std::size_t write_segments(int fd, std::span<const std::span<const uint8_t>> parts)
+{
+    // well below IOV_MAX everywhere
+    constexpr std::size_t maxVectors = 64;
+
+    std::size_t index = 0;
+    std::size_t offset = 0;
+    std::size_t written = 0;
+    while (true)
+    {
+        while (index < parts.size() && parts[index].empty())
+        {
+            ++index;
+        }
+        if (index == parts.size())
+        {
+            return written;
+        }
+
+        std::array<iovec, maxVectors> vectors;
+        std::size_t                   count = 0;
+        for (std::size_t i = index; i < parts.size() && count < maxVectors; ++i, ++count)
+        {
+            const std::size_t skip = i == index ? offset : 0;
+            vectors[count] = { const_cast<uint8_t*>(parts[i].data() + skip), parts[i].size() - skip };
+        }
+
+        const ssize_t result = ::writev(fd, vectors.data(), static_cast<int>(count));
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "writev");
+        }
+        if (result == 0) [[unlikely]]
+        {
+            // the first part isn't empty, so no progress would ever be made by trying again
+            throw std::system_error(std::make_error_code(std::errc::io_error), "writev wrote nothing");
+        }
+
+        // a partial write resumes in the middle of a part
+        written += static_cast<std::size_t>(result);
+        for (auto left = static_cast<std::size_t>(result); left > 0;)
+        {
+            const std::size_t rest = parts[index].size() - offset;
+            if (left >= rest)
+            {
+                left -= rest;
+                ++index;
+                offset = 0;
+            }
+            else
+            {
+                offset += left;
+                left = 0;
+            }
+        }
+    }
+}
+#endif
+
+/**
+ * Output collected in a chain of fixed size blocks taken from a memory resource. Unlike a vector, it never moves what
+ * has already been written when it grows, so encoding a large object copies each byte once. The blocks can be handed
+ * to `writev()` as they are, decoded in place through `segmented_input`, or flattened into one buffer at the end.
+ * After `clear()` the blocks are written over again rather than freed.
+ */
+class chunk_chain final : public sink
+{
+public:
+    static constexpr std::size_t default_block_size = 64 * 1024;
+
+    explicit chunk_chain(std::size_t inBlockSize = default_block_size, std::pmr::memory_resource& inResource = *std::pmr::get_default_resource())
+        : blockSize(inBlockSize == 0 ? default_block_size : inBlockSize), resource(&inResource)
+    {
+    }
+
+    chunk_chain(chunk_chain&& other) noexcept
+        : sink(other), blockSize(other.blockSize), resource(other.resource), blocks(std::move(other.blocks)), used(std::exchange(other.used, 0))
+    {
+        other.blocks.clear();
+        other.reset();
+    }
+
+    chunk_chain(const chunk_chain&) = delete;
+    chunk_chain& operator=(const chunk_chain&) = delete;
+    chunk_chain& operator=(chunk_chain&&) = delete;
+
+    ~chunk_chain() override
+    {
+        for (auto* block : blocks)
+        {
+            resource->deallocate(block, blockSize);
+        }
+    }
+
+    std::size_t block_size() const noexcept { return blockSize; }
+
+    /**
+     * The bytes written so far, one span per block.
+     */
+    std::vector<std::span<const uint8_t>> segments() const
+    {
+        std::vector<std::span<const uint8_t>> result;
+        result.reserve(used);
+        for (std::size_t i = 0; i < used; ++i)
+        {
+            result.emplace_back(blocks[i], i + 1 == used ? static_cast<std::size_t>(cursor - start) : blockSize);
+        }
+        return result;
+    }
+
+    /**
+     * Copies the bytes written so far into one buffer.
+     */
+    std::vector<uint8_t> flatten() const
+    {
+        std::vector<uint8_t> result;
+        result.reserve(size());
+        for (const auto segment : segments())
+        {
+            result.insert(result.end(), segment.begin(), segment.end());
+        }
+        return result;
+    }
+
+    /**
+     * Forgets what was written, keeping the blocks to write the next output into.
+     */
+    void clear() noexcept
+    {
+        used = 0;
+        reset();
+    }
+
+#if __has_include(<sys/uio.h>)
+    /**
+     * Writes the bytes written so far to the file descriptor `fd` with as few `writev()` calls as it takes. Throws
+     * `std::system_error` if writing fails.
+     * @param fd
+     * @return The number of bytes written
+     */
+    std::size_t write_to(int fd) const { return write_segments(fd, segments()); }
+#endif
+
+private:
+    std::size_t                blockSize;
+    std::pmr::memory_resource* resource;
+    std::vector<uint8_t*>      blocks;
+    // blocks that have been written to, the last one of them is the current one
+    std::size_t used = 0;
+
+    void reset() noexcept
+    {
+        start = cursor = limit = nullptr;
+        before = 0;
+    }
+
+    void overflow() override
+    {
+        if (used == blocks.size())
+        {
+            auto* block = static_cast<uint8_t*>(resource->allocate(blockSize));
+            try
+            {
+                blocks.push_back(block);
+            }
+            catch (...)
+            {
+                resource->deallocate(block, blockSize);
+                throw;
+            }
+        }
+        start = cursor = blocks[used++];
+        limit = start + blockSize;
+    }
+};
+
+/**
+ * Output that refers to the large strings and byte vectors of the object being serialized instead of copying them.
+ * Everything else, and runs shorter than `borrowThreshold` bytes, is copied into scratch blocks. The result is a list
+ * of parts, alternating between scratch and borrowed bytes, to be written with a single `writev()` or `sendmsg()`.
+ * The object has to stay alive and unchanged until the parts have been written.
+ */
+class gather_output final : public sink
+{
+public:
+    static constexpr std::size_t default_borrow_threshold = 4 * 1024;
+    static constexpr std::size_t scratch_block_size = 16 * 1024;
+
+    explicit gather_output(std::size_t inBorrowThreshold = default_borrow_threshold)
+    {
+        borrowThreshold = inBorrowThreshold == 0 ? 1 : inBorrowThreshold;
+    }
+
+    gather_output(const gather_output&) = delete;
+    gather_output& operator=(const gather_output&) = delete;
+
+    /**
+     * The bytes written so far, in order.
+     */
+    std::span<const std::span<const uint8_t>> segments()
+    {
+        closePart();
+        return parts;
+    }
+
+    /**
+     * Copies the bytes written so far into one buffer.
+     */
+    std::vector<uint8_t> flatten()
+    {
+        std::vector<uint8_t> result;
+        result.reserve(size());
+        for (const auto part : segments())
+        {
+            result.insert(result.end(), part.begin(), part.end());
+        }
+        return result;
+    }
+
+    /**
+     * Forgets what was written, keeping the scratch blocks.
+     */
+    void clear() noexcept
+    {
+        parts.clear();
+        used = 0;
+        partStart = start = cursor = limit = nullptr;
+        before = 0;
+    }
+
+#if __has_include(<sys/uio.h>)
+    /**
+     * Writes the bytes written so far to the file descriptor `fd`. Throws `std::system_error` if writing fails.
+     * @param fd
+     * @return The number of bytes written
+     */
+    std::size_t write_to(int fd) { return write_segments(fd, segments()); }
+#endif
+
+private:
+    std::vector<std::span<const uint8_t>>  parts;
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    std::size_t                             used = 0;
+    // where the bytes copied since the last part was closed start
+    uint8_t* partStart = nullptr;
+
+    void closePart()
+    {
+        if (cursor != partStart)
+        {
+            parts.emplace_back(partStart, cursor);
+            partStart = cursor;
+        }
+    }
+
+    void overflow() override
+    {
+        closePart();
+        if (used == blocks.size())
+        {
+            blocks.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[scratch_block_size]));
+        }
+        partStart = start = cursor = blocks[used++].get();
+        limit = start + scratch_block_size;
+    }
+
+    void borrow(const void* data, std::size_t size) override
+    {
+        closePart();
+        parts.emplace_back(static_cast<const uint8_t*>(data), size);
+        before += static_cast<std::size_t>(cursor - start) + size;
+        start = cursor;
+    }
+};
+
+/**
+ * Output written straight into memory owned by the caller, which is never reallocated or outgrown. Bytes that don't
+ * fit are counted but dropped, so that after an overflow `size()` tells how much room the whole output needs.
+ */
+class span_output final : public sink
+{
+public:
+    explicit span_output(std::span<uint8_t> out) noexcept
+    {
+        start = cursor = out.data();
+        limit = start + out.size();
+    }
+
+    span_output(const span_output&) = delete;
+    span_output& operator=(const span_output&) = delete;
+
+    /**
+     * Whether more was written than fits.
+     */
+    bool overflowed() const noexcept { return dropping; }
+
+private:
+    std::array<uint8_t, 256> discarded;
+    bool                     dropping = false;
+
+    void overflow() override
+    {
+        dropping = true;
+        start = cursor = discarded.data();
+        limit = start + discarded.size();
+    }
+};
+
+/**
+ * Output kept in `N` bytes of inline storage, spilling over into a heap buffer only once it outgrows them, so that
+ * encoding a small message allocates nothing. The bytes stay contiguous either way.
+ * @tparam N
+ */
+template <std::size_t N> class small_buffer final : public sink
+{
+    static_assert(N > 0, "A small_buffer needs some inline storage");
+
+public:
+    small_buffer() noexcept { reset(); }
+
+    small_buffer(const small_buffer& other) : sink()
+    {
+        reset();
+        write(other.data(), other.size());
+    }
+
+    small_buffer(small_buffer&& other) noexcept : sink()
+    {
+        if (other.heap != nullptr)
+        {
+            heap = std::move(other.heap);
+            start = other.start;
+            cursor = other.cursor;
+            limit = other.limit;
+            other.reset();
+        }
+        else
+        {
+            reset();
+            std::memcpy(storage.data(), other.storage.data(), other.size());
+            cursor = start + other.size();
+        }
+    }
+
+    small_buffer& operator=(const small_buffer&) = delete;
+    small_buffer& operator=(small_buffer&&) = delete;
+
+    const uint8_t* data() const noexcept { return start; }
+
+    std::size_t capacity() const noexcept { return static_cast<std::size_t>(limit - start); }
+
+    /**
+     * Whether the output has outgrown the inline storage.
+     */
+    bool spilled() const noexcept { return heap != nullptr; }
+
+    const uint8_t* begin() const noexcept { return start; }
+    const uint8_t* end() const noexcept { return cursor; }
+
+    operator std::span<const uint8_t>() const noexcept { return std::span<const uint8_t>(start, cursor); }
+
+    std::vector<uint8_t> to_vector() const { return std::vector<uint8_t>(start, cursor); }
+
+    /**
+     * Forgets what was written, keeping the heap buffer if there is one.
+     */
+    void clear() noexcept { cursor = start; }
+
+private:
+    std::array<uint8_t, N>     storage;
+    std::unique_ptr<uint8_t[]> heap;
+
+    void reset() noexcept
+    {
+        heap.reset();
+        start = cursor = storage.data();
+        limit = start + N;
+        before = 0;
+    }
+
+    void overflow() override
+    {
+        // grown in place rather than chained, everything stays in one buffer
+        const auto used = static_cast<std::size_t>(cursor - start);
+        auto       grown = std::unique_ptr<uint8_t[]>(new uint8_t[used * 2]);
+        std::memcpy(grown.get(), start, used);
+        heap = std::move(grown);
+        start = heap.get();
+        cursor = start + used;
+        limit = start + used * 2;
+        before = 0;
+    }
+};
+
+} // namespace borsh
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+#ifndef BORSH_CPP20_OVERLAY_H
+#define BORSH_CPP20_OVERLAY_H
+
+#include "concepts.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+
+namespace borsh
+{
+
+/**
+ * Aggregates without a hand-written serialize() function whose encoding has the same size for every value, so that
+ * each of their fields sits at a constant offset.
+ */
+template <typename T>
+concept FixedLayoutType = AggregateType<T> && !CustomSerializable<T> && FixedWireSize<T>;
+
+template <typename List> struct type_list_tuple;
+
+template <typename... Ts> struct type_list_tuple<type_list<Ts...>>
+{
+    using type = std::tuple<Ts...>;
+};
+
+/**
+ * The type of the `I`th field of an aggregate.
+ */
+template <FixedLayoutType T, std::size_t I>
+using field_type_t = std::tuple_element_t<I, typename type_list_tuple<field_types_t<T>>::type>;
+
+template <typename... Fields> consteval auto field_wire_offsets(type_list<Fields...>)
+{
+    std::array<std::size_t, sizeof...(Fields) + 1> offsets{};
+    std::size_t                                    index = 0;
+    ((offsets[index + 1] = offsets[index] + wire_size<Fields>(), ++index), ...);
+    return offsets;
+}
+
+/**
+ * Where the `I`th field of an aggregate starts in its encoding.
+ */
+template <FixedLayoutType T, std::size_t I>
+inline constexpr std::size_t field_offset_v = field_wire_offsets(field_types_t<T>{})[I];
+
+/**
+ * A view of an encoded `T` right in its serialized bytes. Each field sits at a constant offset and is read or written
+ * on its own, as an unaligned little endian value, without decoding or encoding the rest of the object. Fields that are
+ * aggregates themselves are returned as nested overlays.
+ * @tparam T
+ * @tparam Byte `const uint8_t` for a read-only view
+ */
+template <FixedLayoutType T, typename Byte = uint8_t> class overlay
+{
+    static_assert(std::is_same_v<std::remove_const_t<Byte>, uint8_t>, "An overlay is a view of bytes");
+
+public:
+    static constexpr std::size_t size = wire_size<T>();
+    static constexpr std::size_t fields = field_count_v<T>;
+
+    /**
+     * Views the first `size` bytes of `inBytes`. Throws `std::out_of_range` if there are fewer.
+     * @param inBytes
+     */
+    explicit overlay(std::span<Byte> inBytes) : bytes(inBytes.data())
+    {
+        if (inBytes.size() < size) [[unlikely]]
+        {
+            throw std::out_of_range("Not enough bytes for an overlay");
+        }
+    }
+
+    template <std::size_t I> auto get() const
+    {
+        static_assert(I < fields, "Field index out of range");
+        using Field = field_type_t<T, I>;
+
+        if constexpr (FixedLayoutType<Field>)
+        {
+            return overlay<Field, Byte>(std::span<Byte>(bytes + field_offset_v<T, I>, wire_size<Field>()));
+        }
+        else
+        {
+            Field          value;
+            const uint8_t* in = bytes + field_offset_v<T, I>;
+            borsh::load(value, in);
+            return value;
+        }
+    }
+
+    template <std::size_t I> void set(const field_type_t<T, I>& value) const
+    {
+        static_assert(!std::is_const_v<Byte>, "Cannot write through a read-only overlay");
+        static_assert(I < fields, "Field index out of range");
+
+        uint8_t* out = bytes + field_offset_v<T, I>;
+        borsh::store(value, out);
+    }
+
+    /**
+     * Decodes the whole object.
+     */
+    T load() const
+    {
+        T              value;
+        const uint8_t* in = bytes;
+        borsh::load(value, in);
+        return value;
+    }
+
+    /**
+     * Encodes the whole object over the bytes.
+     */
+    void store(const T& value) const
+    {
+        static_assert(!std::is_const_v<Byte>, "Cannot write through a read-only overlay");
+
+        uint8_t* out = bytes;
+        borsh::store(value, out);
+    }
+
+    std::span<Byte, size> data() const noexcept { return std::span<Byte, size>(bytes, size); }
+
+private:
+    Byte* bytes;
+};
+
+template <FixedLayoutType T> using const_overlay = overlay<T, const uint8_t>;
+
+} // namespace borsh
+
+#endif
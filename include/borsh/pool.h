@@ -0,0 +1,273 @@
+#pragma once
+#ifndef BORSH_CPP20_POOL_H
+#define BORSH_CPP20_POOL_H
+
+#include "concepts.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace borsh
+{
+
+class buffer_pool;
+
+/**
+ * A buffer borrowed from a `buffer_pool`, handed back to it when the handle is destroyed. The pool has to outlive it.
+ */
+class pooled_buffer
+{
+public:
+    pooled_buffer() noexcept = default;
+
+    pooled_buffer(buffer_pool& inPool, std::vector<uint8_t>* inBuffer) noexcept : pool(&inPool), buffer(inBuffer) {}
+
+    pooled_buffer(pooled_buffer&& other) noexcept : pool(other.pool), buffer(std::exchange(other.buffer, nullptr)) {}
+
+    pooled_buffer& operator=(pooled_buffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            giveBack();
+            pool = other.pool;
+            buffer = std::exchange(other.buffer, nullptr);
+        }
+        return *this;
+    }
+
+    pooled_buffer(const pooled_buffer&) = delete;
+    pooled_buffer& operator=(const pooled_buffer&) = delete;
+
+    ~pooled_buffer() { giveBack(); }
+
+    // only for a handle that holds a buffer
+    std::vector<uint8_t>&       operator*() noexcept { return *buffer; }
+    const std::vector<uint8_t>& operator*() const noexcept { return *buffer; }
+    std::vector<uint8_t>*       operator->() noexcept { return buffer; }
+    const std::vector<uint8_t>* operator->() const noexcept { return buffer; }
+
+    explicit operator bool() const noexcept { return buffer != nullptr; }
+
+    // an empty handle, default constructed or moved from, holds no bytes
+    const uint8_t* data() const noexcept { return buffer != nullptr ? buffer->data() : nullptr; }
+    std::size_t    size() const noexcept { return buffer != nullptr ? buffer->size() : 0; }
+
+    operator std::span<const uint8_t>() const noexcept { return std::span<const uint8_t>(data(), size()); }
+
+    /**
+     * Takes the buffer out of the pool for good, an empty handle gives an empty vector.
+     */
+    std::vector<uint8_t> release()
+    {
+        if (buffer == nullptr)
+        {
+            return {};
+        }
+        std::vector<uint8_t> result = std::move(*buffer);
+        delete std::exchange(buffer, nullptr);
+        return result;
+    }
+
+private:
+    buffer_pool*          pool = nullptr;
+    std::vector<uint8_t>* buffer = nullptr;
+
+    inline void giveBack() noexcept;
+};
+
+/**
+ * Output buffers kept around between encodes, so that a loop serializing messages of similar sizes writes into memory
+ * that is already allocated and paged in, rather than growing a new vector from nothing every time. Buffers are sorted
+ * into power of two size classes by capacity, each holding a few of them in slots that are taken and filled with
+ * atomic exchanges, so threads can share a pool without locks. Buffers that don't find a free slot are freed.
+ */
+class buffer_pool
+{
+public:
+    static constexpr std::size_t min_class_bits = 10;
+    static constexpr std::size_t max_class_bits = 26;
+    static constexpr std::size_t slots_per_class = 8;
+
+    buffer_pool() = default;
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    ~buffer_pool()
+    {
+        for (auto& sizeClass : classes)
+        {
+            for (auto& slot : sizeClass)
+            {
+                delete slot.load(std::memory_order_acquire);
+            }
+        }
+    }
+
+    /**
+     * A pool shared by the whole program.
+     */
+    static buffer_pool& shared()
+    {
+        static buffer_pool pool;
+        return pool;
+    }
+
+    /**
+     * An empty buffer with room for at least `capacity` bytes, the smallest one available if there are any.
+     * @param capacity
+     * @return
+     */
+    pooled_buffer acquire(std::size_t capacity = 0)
+    {
+        for (std::size_t index = classOf(capacity); index < classes.size(); ++index)
+        {
+            for (auto& slot : classes[index])
+            {
+                if (slot.load(std::memory_order_relaxed) == nullptr)
+                {
+                    continue;
+                }
+                if (auto* buffer = slot.exchange(nullptr, std::memory_order_acquire))
+                {
+                    return pooled_buffer(*this, buffer);
+                }
+            }
+        }
+
+        // rounded up to a whole class, so that the buffer satisfies requests like this one once it is given back,
+        // unless it is too large to be kept at all
+        constexpr std::size_t largest = std::size_t{ 1 } << max_class_bits;
+        auto                  buffer = std::make_unique<std::vector<uint8_t>>();
+        buffer->reserve(std::max(capacity <= largest ? std::bit_ceil(capacity) : capacity, std::size_t{ 1 } << min_class_bits));
+        return pooled_buffer(*this, buffer.release());
+    }
+
+    /**
+     * Number of buffers waiting in the pool.
+     */
+    std::size_t size() const noexcept
+    {
+        std::size_t count = 0;
+        for (const auto& sizeClass : classes)
+        {
+            for (const auto& slot : sizeClass)
+            {
+                count += slot.load(std::memory_order_relaxed) != nullptr;
+            }
+        }
+        return count;
+    }
+
+private:
+    friend class pooled_buffer;
+
+    using Slot = std::atomic<std::vector<uint8_t>*>;
+
+    std::array<std::array<Slot, slots_per_class>, max_class_bits - min_class_bits + 1> classes{};
+
+    /**
+     * The smallest class whose buffers all have room for `capacity` bytes.
+     */
+    static std::size_t classOf(std::size_t capacity) noexcept
+    {
+        const std::size_t bits = capacity <= 1 ? 0 : static_cast<std::size_t>(std::bit_width(capacity - 1));
+        return bits <= min_class_bits ? 0 : bits - min_class_bits;
+    }
+
+    void giveBack(std::vector<uint8_t>* buffer) noexcept
+    {
+        buffer->clear();
+
+        // the class whose buffers have at least this much room
+        const auto bits = static_cast<std::size_t>(std::bit_width(buffer->capacity())) - 1;
+        if (buffer->capacity() == 0 || bits < min_class_bits || bits > max_class_bits)
+        {
+            delete buffer;
+            return;
+        }
+
+        for (auto& slot : classes[bits - min_class_bits])
+        {
+            std::vector<uint8_t>* empty = nullptr;
+            if (slot.load(std::memory_order_relaxed) == nullptr
+                && slot.compare_exchange_strong(empty, buffer, std::memory_order_release, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+        delete buffer;
+    }
+};
+
+inline void pooled_buffer::giveBack() noexcept
+{
+    if (buffer != nullptr)
+    {
+        pool->giveBack(std::exchange(buffer, nullptr));
+    }
+}
+
+/**
+ * Serializes an object into a buffer from `pool`, which goes back to the pool once the returned handle is destroyed.
+ * @tparam T
+ * @param object
+ * @param pool
+ * @param capacity How many bytes the encoding is expected to take up, if it's not the `expected_size()` of `T`
+ * @return
+ */
+template <typename T> pooled_buffer serialize(const T& object, buffer_pool& pool, std::size_t capacity = 0)
+{
+    // checked here rather than as a constraint, which `CustomSerializable` would depend on while looking for a
+    // serialize(T&, Serializer&) function
+    static_assert(Serializable<T>, "T must be serializable");
+
+    pooled_buffer  buffer = pool.acquire(capacity != 0 ? capacity : expected_size<T>());
+    const uint8_t* data = buffer->data();
+    Serializer     serializer(*buffer, data, SerializerDirection::Serialize);
+    serializer(object);
+    if constexpr (CapacityLearned<T>)
+    {
+        capacity_hint<std::remove_cv_t<T>>::observe(buffer.size());
+    }
+    return buffer;
+}
+
+/**
+ * The buffer `serialize_scratch()` writes to, one per thread and shared by all types.
+ */
+inline std::vector<uint8_t>& scratch_buffer() noexcept
+{
+    thread_local std::vector<uint8_t> scratch;
+    return scratch;
+}
+
+/**
+ * Serializes an object into a buffer owned by the calling thread, which keeps its capacity from one call to the next.
+ * The returned bytes are only valid until the next call on the same thread.
+ * @tparam T
+ * @param object
+ * @return
+ */
+template <Serializable T> std::span<const uint8_t> serialize_scratch(const T& object)
+{
+    auto& scratch = scratch_buffer();
+
+    scratch.clear();
+    const uint8_t* data = scratch.data();
+    Serializer     serializer(scratch, data, SerializerDirection::Serialize);
+    serializer(object);
+    return scratch;
+}
+
+} // namespace borsh
+
+#endif
@@ -0,0 +1,396 @@
+#pragma once
+#ifndef BORSH_CPP20_REFLECTION_H
+#define BORSH_CPP20_REFLECTION_H
+
+#include "concepts.h"
+
+#include <bit>
+#include <cstddef>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+namespace borsh
+{
+
+/**
+ * Stand-in for an arbitrary field while probing how many initializers an aggregate accepts. It is never evaluated,
+ * only used in unevaluated requires-expressions.
+ */
+struct any_field
+{
+    // std::optional has a converting constructor that accepts any_field as well, which would make the conversion
+    // ambiguous, so leave optional fields to that constructor
+    template <typename T>
+        requires(!is_optional<T>::value)
+    constexpr operator T() const noexcept; // NOLINT(google-explicit-constructor)
+};
+
+inline constexpr std::size_t max_aggregate_fields = 32;
+
+template <typename T, typename... Fields> consteval std::size_t field_count()
+{
+    if constexpr (sizeof...(Fields) > max_aggregate_fields)
+    {
+        return sizeof...(Fields);
+    }
+    else if constexpr (requires { T{ Fields{}..., any_field{} }; })
+    {
+        return field_count<T, Fields..., any_field>();
+    }
+    else
+    {
+        return sizeof...(Fields);
+    }
+}
+
+template <AggregateType T> inline constexpr std::size_t field_count_v = field_count<std::remove_cv_t<T>>();
+
+/**
+ * Calls `visitor` once with references to every field of an aggregate, in declaration order.
+ * @tparam T
+ * @tparam Visitor
+ * @param value
+ * @param visitor
+ * @return whatever the visitor returns
+ */
+template <AggregateType T, typename Visitor> constexpr decltype(auto) visit_fields(T& value, Visitor&& visitor)
+{
+    constexpr std::size_t count = field_count_v<T>;
+    static_assert(count <= max_aggregate_fields, "Aggregate has too many fields to be serialized automatically");
+
+    if constexpr (count == 0)
+    {
+        return visitor();
+    }
+    else if constexpr (count == 1)
+    {
+        auto& [f0] = value;
+        return visitor(f0);
+    }
+    else if constexpr (count == 2)
+    {
+        auto& [f0, f1] = value;
+        return visitor(f0, f1);
+    }
+    else if constexpr (count == 3)
+    {
+        auto& [f0, f1, f2] = value;
+        return visitor(f0, f1, f2);
+    }
+    else if constexpr (count == 4)
+    {
+        auto& [f0, f1, f2, f3] = value;
+        return visitor(f0, f1, f2, f3);
+    }
+    else if constexpr (count == 5)
+    {
+        auto& [f0, f1, f2, f3, f4] = value;
+        return visitor(f0, f1, f2, f3, f4);
+    }
+    else if constexpr (count == 6)
+    {
+        auto& [f0, f1, f2, f3, f4, f5] = value;
+        return visitor(f0, f1, f2, f3, f4, f5);
+    }
+    else if constexpr (count == 7)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6);
+    }
+    else if constexpr (count == 8)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7);
+    }
+    else if constexpr (count == 9)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8);
+    }
+    else if constexpr (count == 10)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9);
+    }
+    else if constexpr (count == 11)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10);
+    }
+    else if constexpr (count == 12)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11);
+    }
+    else if constexpr (count == 13)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12);
+    }
+    else if constexpr (count == 14)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13);
+    }
+    else if constexpr (count == 15)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14);
+    }
+    else if constexpr (count == 16)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15);
+    }
+    else if constexpr (count == 17)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16);
+    }
+    else if constexpr (count == 18)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17);
+    }
+    else if constexpr (count == 19)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18);
+    }
+    else if constexpr (count == 20)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19);
+    }
+    else if constexpr (count == 21)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20);
+    }
+    else if constexpr (count == 22)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21);
+    }
+    else if constexpr (count == 23)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22);
+    }
+    else if constexpr (count == 24)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23);
+    }
+    else if constexpr (count == 25)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24);
+    }
+    else if constexpr (count == 26)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25);
+    }
+    else if constexpr (count == 27)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26);
+    }
+    else if constexpr (count == 28)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27);
+    }
+    else if constexpr (count == 29)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28);
+    }
+    else if constexpr (count == 30)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29);
+    }
+    else if constexpr (count == 31)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29, f30] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29, f30);
+    }
+    else if constexpr (count == 32)
+    {
+        auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29, f30, f31] = value;
+        return visitor(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29, f30, f31);
+    }
+}
+
+template <typename... Ts> struct type_list
+{
+};
+
+template <AggregateType T>
+using field_types_t = decltype(visit_fields(std::declval<T&>(), [](auto&... fields) { return type_list<std::remove_cvref_t<decltype(fields)>...>{}; }));
+
+template <typename T> consteval bool is_wire_compatible();
+
+template <typename... Fields> consteval bool are_wire_compatible(type_list<Fields...>)
+{
+    return (is_wire_compatible<Fields>() && ...);
+}
+
+/**
+ * A type is wire compatible when its in-memory representation is byte for byte its borsh encoding: little endian
+ * integers, no padding, no floats (which need a NaN check), no bools (which have to be checked to be 0 or 1) and, for
+ * aggregates, fields serialized in declaration order without a hand-written serialize() function that could reorder
+ * or skip them.
+ */
+template <typename T> consteval bool is_wire_compatible()
+{
+    if constexpr (std::endian::native != std::endian::little)
+    {
+        return false;
+    }
+    else if constexpr (IsTriviallySerializable<T>::value)
+    {
+        return true;
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        return false;
+    }
+    else if constexpr (IntegralType<T>)
+    {
+        return std::has_unique_object_representations_v<T>;
+    }
+    else if constexpr (std::is_bounded_array_v<T>)
+    {
+        return is_wire_compatible<std::remove_cv_t<std::remove_all_extents_t<T>>>();
+    }
+    else if constexpr (is_std_array_v<T>)
+    {
+        return std::has_unique_object_representations_v<T> && is_wire_compatible<std::remove_cv_t<typename T::value_type>>();
+    }
+    else if constexpr (AggregateType<T> && !CustomSerializable<T>)
+    {
+        if constexpr (std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>)
+        {
+            return are_wire_compatible(field_types_t<T>{});
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+}
+
+/**
+ * Types that are encoded and decoded with a single bulk copy of their object representation, either because they
+ * were detected as wire compatible or because they opted in through `IsTriviallySerializable`.
+ */
+template <typename T>
+concept TriviallySerializable = std::is_trivially_copyable_v<std::remove_cv_t<T>> && is_wire_compatible<std::remove_cv_t<T>>();
+
+/**
+ * Returned by `wire_size()` for types whose encoded size depends on their value.
+ */
+inline constexpr std::size_t dynamic_wire_size = static_cast<std::size_t>(-1);
+
+template <typename T> consteval std::size_t wire_size();
+
+template <typename... Fields> consteval std::size_t wire_size_of(type_list<Fields...>)
+{
+    if constexpr (((wire_size<Fields>() == dynamic_wire_size) || ...))
+    {
+        return dynamic_wire_size;
+    }
+    else
+    {
+        return (std::size_t{ 0 } + ... + wire_size<Fields>());
+    }
+}
+
+/**
+ * The number of bytes every value of `T` is encoded into, or `dynamic_wire_size`. Types with a hand-written
+ * serialize() function are always dynamic since there is no telling what it writes.
+ */
+template <typename T> consteval std::size_t wire_size()
+{
+    if constexpr (IntegralType<T> || std::is_same_v<T, float> || std::is_same_v<T, double> || TriviallySerializable<T>)
+    {
+        return sizeof(T);
+    }
+    else if constexpr (std::is_bounded_array_v<T> || is_std_array_v<T>)
+    {
+        using Element = std::remove_cv_t<std::ranges::range_value_t<T>>;
+        constexpr std::size_t elementSize = wire_size<Element>();
+        return elementSize == dynamic_wire_size ? dynamic_wire_size : elementSize * (sizeof(T) / sizeof(Element));
+    }
+    else if constexpr (AggregateType<T> && !CustomSerializable<T>)
+    {
+        return wire_size_of(field_types_t<T>{});
+    }
+    else
+    {
+        return dynamic_wire_size;
+    }
+}
+
+template <typename T>
+concept FixedWireSize = wire_size<std::remove_cv_t<T>>() != dynamic_wire_size;
+
+template <typename T> consteval bool is_fully_decoded();
+
+template <typename... Fields> consteval bool are_fully_decoded(type_list<Fields...>)
+{
+    return (is_fully_decoded<Fields>() && ...);
+}
+
+/**
+ * A type is fully decoded when, after default-initializing it, decoding is guaranteed to leave no member with an
+ * indeterminate value: every scalar in it is read from the input, and every class type in it that isn't read field by
+ * field is one whose default constructor already initializes it, like a string, container or pointer.
+ */
+template <typename T> consteval bool is_fully_decoded()
+{
+    if constexpr (IsFullyDecoded<T>::value || NumericType<T> || TriviallySerializable<T> || NumericRunType<T>)
+    {
+        return true;
+    }
+    else if constexpr (StringType<T> || SerializableVector<T> || is_std_map_v<T> || is_std_set_v<T> || is_jagged<T>::value
+        || is_optional<T>::value || is_box<T>::value || is_interned<T>::value)
+    {
+        return true;
+    }
+    else if constexpr (std::is_bounded_array_v<T>)
+    {
+        return is_fully_decoded<std::remove_cv_t<std::remove_all_extents_t<T>>>();
+    }
+    else if constexpr (is_std_array_v<T>)
+    {
+        return is_fully_decoded<std::remove_cv_t<typename T::value_type>>();
+    }
+    else if constexpr (AggregateType<T> && !CustomSerializable<T>)
+    {
+        return are_fully_decoded(field_types_t<T>{});
+    }
+    else
+    {
+        return false;
+    }
+}
+
+/**
+ * Types that can be default-initialized instead of value-initialized before being deserialized into, since decoding
+ * overwrites whatever default-initialization left indeterminate. Large fixed size buffers are then never zeroed.
+ */
+template <typename T>
+concept FullyDecoded = is_fully_decoded<std::remove_cv_t<T>>();
+
+} // namespace borsh
+
+#endif
@@ -0,0 +1,182 @@
+#pragma once
+#ifndef BORSH_CPP20_SEGMENTS_H
+#define BORSH_CPP20_SEGMENTS_H
+
+#include "concepts.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace borsh
+{
+
+class Serializer;
+
+/**
+ * Input that arrives split over several buffers, such as a chain of network segments, read as if it was one. Fields
+ * that lie within one segment are read from it in place. Only a field that straddles the end of a segment is first
+ * copied together into a small stitching buffer, and bulk copies are split at the segment ends instead. Each decode
+ * picks up where the previous one stopped, so consecutive objects can be read off the same chain.
+ *
+ * The segments are not copied, they have to stay alive and unchanged while they are read.
+ */
+class segmented_input
+{
+public:
+    explicit segmented_input(std::span<const std::span<const uint8_t>> inSegments) noexcept : segments(inSegments)
+    {
+        for (const auto& segment : segments)
+        {
+            total += segment.size();
+        }
+    }
+
+    // the window may point into the stitching buffer
+    segmented_input(const segmented_input&) = delete;
+    segmented_input& operator=(const segmented_input&) = delete;
+
+    /**
+     * Number of bytes read so far.
+     */
+    std::size_t consumed() const noexcept { return before + static_cast<std::size_t>(cursor - windowStart); }
+
+    /**
+     * Number of bytes left to read.
+     */
+    std::size_t remaining() const noexcept { return total - consumed(); }
+
+private:
+    friend class Serializer;
+
+    std::span<const std::span<const uint8_t>> segments;
+    std::size_t                               total = 0;
+
+    // the bytes being read from, either part of a segment or the stitching buffer
+    const uint8_t* cursor = nullptr;
+    const uint8_t* windowStart = nullptr;
+    const uint8_t* windowEnd = nullptr;
+    // how many bytes of input come before the window
+    std::size_t before = 0;
+
+    // where the bytes following the window are
+    std::size_t next = 0;
+    std::size_t nextOffset = 0;
+
+    std::vector<uint8_t> stitch;
+
+    /**
+     * Moves the window on to the rest of the next segment once it has been read up to its end.
+     * @return false if there is no input left
+     */
+    bool advance() noexcept
+    {
+        if (next == segments.size())
+        {
+            return false;
+        }
+
+        before += static_cast<std::size_t>(windowEnd - windowStart);
+        const auto& segment = segments[next];
+        windowStart = cursor = segment.data() + nextOffset;
+        windowEnd = segment.data() + segment.size();
+        ++next;
+        nextOffset = 0;
+        return true;
+    }
+
+    /**
+     * Makes the window start with at least `size` contiguous bytes, stitching them together if they are spread over
+     * several segments. Throws `incomplete_input` if fewer are left.
+     * @param size
+     */
+    void acquire(std::size_t size)
+    {
+        if (remaining() < size) [[unlikely]]
+        {
+            throw incomplete_input(consumed() + size);
+        }
+
+        while (cursor == windowEnd && advance())
+        {
+        }
+        if (static_cast<std::size_t>(windowEnd - cursor) >= size)
+        {
+            return;
+        }
+
+        const std::size_t position = consumed();
+        const auto        available = static_cast<std::size_t>(windowEnd - cursor);
+        if (available > 0 && windowStart == stitch.data())
+        {
+            // the window is the stitching buffer already, its unread bytes move to its front
+            std::memmove(stitch.data(), cursor, available);
+            stitch.resize(size);
+        }
+        else
+        {
+            stitch.resize(size);
+            if (available > 0)
+            {
+                std::memcpy(stitch.data(), cursor, available);
+            }
+        }
+
+        for (std::size_t filled = available; filled < size;)
+        {
+            const auto&       segment = segments[next];
+            const std::size_t count = std::min(size - filled, segment.size() - nextOffset);
+            if (count > 0)
+            {
+                std::memcpy(stitch.data() + filled, segment.data() + nextOffset, count);
+            }
+            filled += count;
+            nextOffset += count;
+            if (nextOffset == segment.size())
+            {
+                ++next;
+                nextOffset = 0;
+            }
+        }
+
+        windowStart = cursor = stitch.data();
+        windowEnd = stitch.data() + size;
+        before = position;
+    }
+
+    /**
+     * Copies the next `size` bytes to `destination`, one segment at a time. Throws `incomplete_input` if fewer are
+     * left.
+     * @param destination
+     * @param size
+     */
+    void read(void* destination, std::size_t size)
+    {
+        if (remaining() < size) [[unlikely]]
+        {
+            throw incomplete_input(consumed() + size);
+        }
+
+        auto* out = static_cast<uint8_t*>(destination);
+        while (size > 0)
+        {
+            while (cursor == windowEnd)
+            {
+                advance();
+            }
+            const std::size_t count = std::min(size, static_cast<std::size_t>(windowEnd - cursor));
+            std::memcpy(out, cursor, count);
+            out += count;
+            cursor += count;
+            size -= count;
+        }
+    }
+};
+
+} // namespace borsh
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef BORSH_CPP20_SEQUENCE_H
+#define BORSH_CPP20_SEQUENCE_H
+
+#include "concepts.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+
+namespace borsh
+{
+
+/**
+ * The objects of type `T` serialized back to back in one buffer, decoded one at a time while iterating. Every object
+ * is decoded into the same instance, so objects with strings or vectors stop allocating once the largest one has been
+ * seen. Iteration ends once all of the input has been consumed, input that ends in the middle of an object throws
+ * `std::out_of_range` when that object is reached.
+ * @tparam T
+ */
+template <Serializable T> class sequence
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        const T& operator*() const noexcept { return current; }
+        const T* operator->() const noexcept { return &current; }
+
+        iterator& operator++()
+        {
+            position = next;
+            decodeCurrent();
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        /**
+         * Where the current object starts.
+         */
+        const uint8_t* data() const noexcept { return position; }
+
+        /**
+         * Number of bytes the current object takes up.
+         */
+        std::size_t size() const noexcept { return static_cast<std::size_t>(next - position); }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept { return it.position == it.end; }
+
+    private:
+        friend class sequence;
+
+        const uint8_t* position = nullptr;
+        const uint8_t* next = nullptr;
+        const uint8_t* end = nullptr;
+        T              current{};
+
+        iterator(const uint8_t* inPosition, const uint8_t* inEnd) : position(inPosition), next(inPosition), end(inEnd)
+        {
+            decodeCurrent();
+        }
+
+        void decodeCurrent()
+        {
+            if (position != end)
+            {
+                next = position + deserialize_into(current, std::span<const uint8_t>(position, end));
+                if (next == position) [[unlikely]]
+                {
+                    throw std::invalid_argument("Cannot iterate over objects that take up no bytes");
+                }
+            }
+        }
+    };
+
+    explicit sequence(std::span<const uint8_t> inInput) noexcept : input(inInput) {}
+
+    iterator begin() const { return iterator(input.data(), input.data() + input.size()); }
+
+    std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+private:
+    std::span<const uint8_t> input;
+};
+
+} // namespace borsh
+
+#endif
@@ -15,124 +15,1207 @@ class Serializer
 {
 public:
     explicit Serializer(std::vector<uint8_t>& inBuffer, const uint8_t*& inBufferPointerReference, SerializerDirection inDirection)
-        : direction(inDirection), buffer(inBuffer), bufferPointerReference(inBufferPointerReference)
+        : direction(inDirection), buffer(&inBuffer), bufferPointerReference(inBufferPointerReference),
+          inputStart(inBufferPointerReference), inputEnd(inBuffer.data() + inBuffer.size())
     {
     }
 
+    /**
+     * Deserializes from `[inBufferPointerReference, inInputEnd)`, advancing `inBufferPointerReference` past every byte
+     * that has been read. Reading beyond `inInputEnd` throws `incomplete_input`.
+     * @param inBufferPointerReference
+     * @param inInputEnd
+     */
+    explicit Serializer(const uint8_t*& inBufferPointerReference, const uint8_t* inInputEnd)
+        : direction(SerializerDirection::Deserialize), buffer(nullptr), bufferPointerReference(inBufferPointerReference),
+          inputStart(inBufferPointerReference), inputEnd(inInputEnd)
+    {
+    }
+
+    /**
+     * Deserializes from `input`, picking up where its last reader stopped.
+     * @param input
+     */
+    explicit Serializer(segmented_input& input)
+        : direction(SerializerDirection::Deserialize), buffer(nullptr), bufferPointerReference(input.cursor), inputStart(input.windowStart),
+          inputEnd(input.windowEnd), segmentedInput(&input)
+    {
+    }
+
+    /**
+     * Serializes to `inOutput` instead of a vector.
+     * @param inOutput
+     */
+    explicit Serializer(sink& inOutput)
+        : direction(SerializerDirection::Serialize), buffer(nullptr), bufferPointerReference(unusedCursor), inputStart(nullptr), inputEnd(nullptr),
+          output(&inOutput)
+    {
+    }
+
+    /**
+     * Where one field of an object starts in its encoding, and how to encode or decode that field again on its own.
+     * `decode` is null for const fields.
+     */
+    struct RecordedField
+    {
+        const void* address;
+        std::size_t size;
+        std::size_t offset;
+        void (*encode)(Serializer&, const void*);
+        void (*decode)(Serializer&, void*);
+    };
+
     template <typename... Args> Serializer& operator()(Args&... args)
     {
-        (visit(args), ...);
-        return *this;
+        ++depth;
+        if (recorder != nullptr && depth == 1) [[unlikely]]
+        {
+            (record(args), ...);
+        }
+        else
+        {
+            visitFrom<0>(std::tuple<Args&...>(args...));
+        }
+        --depth;
+
+        if (depth == 0 && pending.size() > pendingBase)
+        {
+            resumePending();
+        }
+        return *this;
+    }
+
+    /**
+     * Nodes of `arena_ptr` fields are allocated from `resource` while deserializing.
+     * @param resource
+     * @return
+     */
+    Serializer& with(std::pmr::memory_resource& resource)
+    {
+        nodeResource = &resource;
+        return *this;
+    }
+
+    /**
+     * Appends every argument of the outermost operator() calls to `fields`, along with the offset it was written to or
+     * read from. Calling a hand-written serialize() function directly with this serializer records the fields of that
+     * object. Unless `visitFields` is set the fields are only recorded, not serialized or deserialized.
+     * @param fields
+     * @param visitFields
+     * @return
+     */
+    Serializer& recording(std::vector<RecordedField>& fields, bool visitFields = true)
+    {
+        recorder = &fields;
+        visitRecorded = visitFields;
+        return *this;
+    }
+
+    /**
+     * `interned` fields share the canonical copies kept by `pool` while deserializing.
+     * @param pool
+     * @return
+     */
+    Serializer& with(intern_pool& pool)
+    {
+        internPool = &pool;
+        return *this;
+    }
+
+private:
+    /**
+     * A visit that has been put off rather than recursed into: the pointee of a Box, an argument of an operator() call
+     * that comes after one, or the elements of a vector that come after one. Pending visits are kept on a stack and
+     * resumed in a loop, the most recent first, before anything else is written or read, so the bytes come out in the
+     * same order as if they had been visited right away, but a structure that nests deeply through Boxes, like a long
+     * list or either spine of a tree, no longer takes up the call stack.
+     */
+    struct PendingVisit
+    {
+        void* object;
+        void (*resume)(Serializer&, const PendingVisit&);
+        // the element to resume from, and how many there are when decoding
+        std::size_t index = 0;
+        std::size_t count = 0;
+    };
+
+    /**
+     * The stack of pending visits. Its first entries are kept in the serializer itself, so that visiting a handful of
+     * Boxes allocates nothing. serialize() functions return the serializer by value, so a copy starts out empty rather
+     * than copying the stack along.
+     */
+    class PendingStack
+    {
+    public:
+        PendingStack() = default;
+        PendingStack(const PendingStack&) noexcept : PendingStack() {}
+        PendingStack& operator=(const PendingStack&) = delete;
+
+        std::size_t size() const noexcept { return visits.size(); }
+
+        void push(const PendingVisit& visit)
+        {
+            if (visits.capacity() == 0)
+            {
+                visits.reserve(inlineCount);
+            }
+            visits.push_back(visit);
+        }
+
+        PendingVisit pop()
+        {
+            const PendingVisit visit = visits.back();
+            visits.pop_back();
+            return visit;
+        }
+
+        /**
+         * Inserts `rest` below the visits from `position` on, which are resumed before them.
+         */
+        template <std::size_t N> void insert(std::size_t position, const std::array<PendingVisit, N>& rest)
+        {
+            visits.insert(visits.begin() + static_cast<std::ptrdiff_t>(position), rest.begin(), rest.end());
+        }
+
+    private:
+        static constexpr std::size_t inlineCount = 16;
+
+        alignas(PendingVisit) std::array<std::byte, inlineCount * sizeof(PendingVisit)> storage;
+
+        std::pmr::monotonic_buffer_resource resource{ storage.data(), storage.size() };
+        std::pmr::vector<PendingVisit>      visits{ &resource };
+    };
+
+    /**
+     * How many times pending visits may be resumed one inside the other. That happens for a Box whose pointee has to be
+     * visited before something that can't be put off, like the next element of a map or of a fixed size array, and
+     * takes up the call stack again, so a structure that nests deeper than this through such Boxes throws instead.
+     */
+    static constexpr std::size_t maxNestedResumes = 1000;
+
+    const SerializerDirection   direction;
+    std::vector<uint8_t>*       buffer;
+    const uint8_t*&             bufferPointerReference;
+    const uint8_t*              inputStart;
+    const uint8_t*              inputEnd;
+    segmented_input*            segmentedInput = nullptr;
+    sink*                       output = nullptr;
+    const uint8_t*              unusedCursor = nullptr;
+    std::pmr::memory_resource*  nodeResource = nullptr;
+    intern_pool*                internPool = nullptr;
+    std::vector<RecordedField>* recorder = nullptr;
+    bool                        visitRecorded = true;
+    std::size_t                 depth = 0;
+    PendingStack                pending;
+    // visits below this one were put off by whatever is being visited further up and have to wait until it's done
+    std::size_t                 pendingBase = 0;
+    std::size_t                 nestedResumes = 0;
+    // the bytes of the object being visited, arguments within it outlive the operator() call they are passed to
+    std::uintptr_t              stableBegin = 0;
+    std::uintptr_t              stableEnd = 0;
+
+    /**
+     * Fields of a fixed wire size up to this many bytes are fused with their neighbours, larger ones are already
+     * copied in bulk on their own.
+     */
+    static constexpr std::size_t maxFusedFieldSize = 64;
+
+    template <typename T> static constexpr bool Fusible = wire_size<std::remove_cv_t<T>>() <= maxFusedFieldSize;
+
+    template <std::size_t I, typename... Args> static consteval std::size_t runEnd()
+    {
+        if constexpr (I < sizeof...(Args))
+        {
+            if constexpr (Fusible<std::tuple_element_t<I, std::tuple<Args...>>>)
+            {
+                return runEnd<I + 1, Args...>();
+            }
+        }
+        return I;
+    }
+
+    /**
+     * Visits the arguments of an operator() call from the `I`th on. Consecutive arguments of a small fixed wire size,
+     * including aggregates made of them which are flattened, form a run whose layout is known at compile time: it is
+     * written with a single capacity check or read with a single bounds check, the fields in between being plain
+     * stores and loads at constant offsets.
+     */
+    template <std::size_t I, typename... Args> void visitFrom(std::tuple<Args&...> args)
+    {
+        if constexpr (I < sizeof...(Args))
+        {
+            if constexpr (Fusible<std::tuple_element_t<I, std::tuple<Args...>>>)
+            {
+                constexpr std::size_t end = runEnd<I, Args...>();
+                visitRun<I>(args, std::make_index_sequence<end - I>{});
+                visitFrom<end>(args);
+            }
+            else
+            {
+                if (depth == 1)
+                {
+                    stabilize(std::get<I>(args));
+                }
+
+                const std::size_t mark = pending.size();
+                visit(std::get<I>(args));
+                if constexpr (I + 1 < sizeof...(Args))
+                {
+                    // the rest of the arguments wait for whatever was put off, unless they don't outlive this call, in
+                    // which case it's resumed before the next of them is visited
+                    if (pending.size() > mark && deferArguments<I + 1>(args, mark, std::make_index_sequence<sizeof...(Args) - I - 1>{}))
+                    {
+                        return;
+                    }
+                }
+                visitFrom<I + 1>(args);
+            }
+        }
+    }
+
+    template <std::size_t First, typename... Args, std::size_t... Indices>
+    void visitRun(std::tuple<Args&...> args, std::index_sequence<Indices...>)
+    {
+        constexpr std::size_t size = (std::size_t{ 0 } + ... + wire_size<std::remove_cv_t<std::tuple_element_t<First + Indices, std::tuple<Args...>>>>());
+
+        if (pending.size() > pendingBase) [[unlikely]]
+        {
+            resumePending();
+        }
+
+        if (direction == SerializerDirection::Serialize)
+        {
+            std::array<uint8_t, size> run;
+            uint8_t*                  out = run.data();
+            (store(std::get<First + Indices>(args), out), ...);
+            write(run.data(), size);
+        }
+        else if constexpr ((std::is_const_v<std::tuple_element_t<First + Indices, std::tuple<Args...>>> || ...))
+        {
+            throw std::runtime_error("Cannot deserialize into a const object");
+        }
+        else
+        {
+            acquire(size);
+            const uint8_t* in = bufferPointerReference;
+            (load(std::get<First + Indices>(args), in), ...);
+            bufferPointerReference = in;
+        }
+    }
+
+    template <typename T> void record(T& field)
+    {
+        using Field = std::remove_const_t<T>;
+
+        if (pending.size() > pendingBase)
+        {
+            resumePending();
+        }
+
+        // an array of unknown bound is no field of an object, it can only be a top level argument
+        if constexpr (!std::is_unbounded_array_v<Field>)
+        {
+            const std::size_t offset = position();
+
+            void (*decodeField)(Serializer&, void*) = nullptr;
+            if constexpr (!std::is_const_v<T>)
+            {
+                decodeField = [](Serializer& serializer, void* address) { serializer(*static_cast<Field*>(address)); };
+            }
+
+            recorder->push_back({ &field, sizeof(Field), offset,
+                [](Serializer& serializer, const void* address) { serializer(*static_cast<const Field*>(address)); }, decodeField });
+        }
+
+        if (visitRecorded)
+        {
+            stabilize(field);
+            visit(field);
+        }
+    }
+
+    template <typename T> void stabilize(const T& object) noexcept
+    {
+        stableBegin = reinterpret_cast<std::uintptr_t>(std::addressof(object));
+        if constexpr (std::is_unbounded_array_v<T>)
+        {
+            // it has no size to tell where it ends
+            stableEnd = stableBegin;
+        }
+        else
+        {
+            stableEnd = stableBegin + sizeof(T);
+        }
+    }
+
+    template <typename T> bool isStable(const T& object) const noexcept
+    {
+        if constexpr (std::is_unbounded_array_v<T>)
+        {
+            return false;
+        }
+        else
+        {
+            const auto address = reinterpret_cast<std::uintptr_t>(std::addressof(object));
+            return address >= stableBegin && address + sizeof(T) <= stableEnd;
+        }
+    }
+
+    /**
+     * Resumes the visits put off since `pendingBase`, along with any they put off in turn, in a loop.
+     */
+    void resumePending()
+    {
+        if (nestedResumes == maxNestedResumes) [[unlikely]]
+        {
+            throw std::runtime_error("Boxes are nested too deeply");
+        }
+
+        const std::size_t    base = pendingBase;
+        const std::uintptr_t begin = stableBegin;
+        const std::uintptr_t end = stableEnd;
+        ++nestedResumes;
+        ++depth;
+        while (pending.size() > base)
+        {
+            const PendingVisit visit = pending.pop();
+            pendingBase = pending.size();
+            visit.resume(*this, visit);
+        }
+        --depth;
+        --nestedResumes;
+        pendingBase = base;
+        stableBegin = begin;
+        stableEnd = end;
+    }
+
+    template <typename T> static PendingVisit pendingVisit(T& object)
+    {
+        return { const_cast<void*>(static_cast<const void*>(std::addressof(object))),
+            [](Serializer& serializer, const PendingVisit& visit) {
+                auto& pendingObject = *static_cast<T*>(visit.object);
+                serializer.stabilize(pendingObject);
+                serializer.visit(pendingObject);
+            } };
+    }
+
+    template <typename T> void defer(T& object)
+    {
+        pending.push(pendingVisit(object));
+    }
+
+    /**
+     * Puts off the arguments from the `First`th on until after the visits put off since `mark`, provided they are part
+     * of an object that outlives the operator() call.
+     */
+    template <std::size_t First, typename... Args, std::size_t... Indices>
+    bool deferArguments(std::tuple<Args&...> args, std::size_t mark, std::index_sequence<Indices...>)
+    {
+        // the arguments of the outermost call outlive it since the visits it puts off are resumed before it returns
+        if (depth > 1 && !(isStable(std::get<First + Indices>(args)) && ...))
+        {
+            return false;
+        }
+
+        // the last pending visit is resumed first
+        constexpr std::size_t                 count = sizeof...(Indices);
+        const std::array<PendingVisit, count> rest = { pendingVisit(std::get<First + count - 1 - Indices>(args))... };
+        pending.insert(mark, rest);
+        return true;
+    }
+
+    /**
+     * Puts off the elements of `value` from the `index`th on until after the visits put off since `mark`, provided
+     * the vector is part of an object that outlives this visit.
+     */
+    template <typename T> bool deferElements(T& value, std::size_t mark, std::size_t index, std::size_t count)
+    {
+        if (!isStable(value))
+        {
+            return false;
+        }
+
+        const std::array<PendingVisit, 1> rest = { PendingVisit{ const_cast<void*>(static_cast<const void*>(std::addressof(value))),
+            [](Serializer& serializer, const PendingVisit& visit) {
+                auto& vector = *static_cast<T*>(visit.object);
+                serializer.stabilize(vector);
+                if constexpr (std::is_const_v<T>)
+                {
+                    serializer.encodeElements(vector, visit.index);
+                }
+                else
+                {
+                    serializer.decodeElements(vector, visit.index, visit.count);
+                }
+            },
+            index, count } };
+        pending.insert(mark, rest);
+        return true;
+    }
+
+    template <typename T> void encodeElements(const T& value, std::size_t from)
+    {
+        for (std::size_t i = from; i < value.size(); ++i)
+        {
+            const std::size_t mark = pending.size();
+            encode(value[i]);
+            if (pending.size() > mark && i + 1 < value.size() && deferElements(value, mark, i + 1, 0))
+            {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Decodes elements from the `from`th on until the vector has `count` of them, in place as long as there already are
+     * elements to decode into, after that appending them.
+     */
+    template <typename T> void decodeElements(T& value, std::size_t from, std::size_t count)
+    {
+        for (std::size_t i = from; i < count; ++i)
+        {
+            const std::size_t mark = pending.size();
+            decode(i < value.size() ? value[i] : value.emplace_back());
+            if (pending.size() > mark && i + 1 < count && deferElements(value, mark, i + 1, count))
+            {
+                return;
+            }
+        }
+    }
+
+    template <BoxType T> static auto& dereference(const T& pointer)
+    {
+        if (pointer == nullptr) [[unlikely]]
+        {
+            throw std::invalid_argument("Cannot serialize a null pointer");
+        }
+        return *pointer;
+    }
+
+    /**
+     * Makes sure `pointer` owns a node to deserialize into. A unique_ptr that already owns one keeps it, a shared_ptr
+     * always gets a fresh node since the old one may be shared with other owners.
+     * @tparam T
+     * @param pointer
+     * @return
+     */
+    template <BoxType T> T& allocate(T& pointer)
+    {
+        using Element = std::remove_const_t<typename T::element_type>;
+
+        if constexpr (requires { pointer.use_count(); })
+        {
+#if __cpp_lib_smart_ptr_for_overwrite
+            if constexpr (FullyDecoded<Element>)
+            {
+                pointer = std::make_shared_for_overwrite<Element>();
+            }
+            else
+#endif
+            {
+                pointer = std::make_shared<Element>();
+            }
+        }
+        else if constexpr (std::is_same_v<typename T::deleter_type, arena_deleter>)
+        {
+            if (pointer == nullptr)
+            {
+                if (nodeResource == nullptr) [[unlikely]]
+                {
+                    throw std::runtime_error("Deserializing an arena_ptr requires a memory resource");
+                }
+                void* memory = nodeResource->allocate(sizeof(Element), alignof(Element));
+                if constexpr (FullyDecoded<Element>)
+                {
+                    pointer.reset(::new (memory) Element);
+                }
+                else
+                {
+                    pointer.reset(::new (memory) Element());
+                }
+            }
+        }
+        else if (pointer == nullptr)
+        {
+#if __cpp_lib_smart_ptr_for_overwrite
+            if constexpr (FullyDecoded<Element>)
+            {
+                pointer = std::make_unique_for_overwrite<Element>();
+            }
+            else
+#endif
+            {
+                pointer = std::make_unique<Element>();
+            }
+        }
+        return pointer;
+    }
+
+    bool readOptionTag()
+    {
+        uint8_t tag;
+        read(&tag, sizeof(tag));
+        if (tag > 1) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid Option tag");
+        }
+        return tag == 1;
+    }
+
+    /**
+     * This handles the execution path for the compiler where a const variable was passed to serialize().
+     * Normally, the compiler would not have access to `direction` at compile-time, therefore trying to
+     * explore the deserialization code path and returning a variety of errors. This helps prevent that
+     * and offloads the undesirable situation to an exception.
+     * @tparam T
+     * @param value
+     */
+    template <typename T> void visit(const T& value)
+    {
+        if (direction == SerializerDirection::Serialize)
+        {
+            encode(value);
+        }
+        else [[unlikely]]
+        {
+            throw std::runtime_error("Cannot deserialize into a const object");
+        }
+    }
+
+    template <typename T> void visit(T& value)
+    {
+        if (direction == SerializerDirection::Serialize)
+        {
+            encode(value);
+        }
+        else
+        {
+            decode(value);
+        }
+    }
+
+    void write(const void* data, std::size_t size)
+    {
+        if (buffer != nullptr) [[likely]]
+        {
+            append(*buffer, data, size);
+        }
+        else
+        {
+            output->write(data, size);
+        }
+    }
+
+    template <typename T> void write(const T& value) { write(&value, sizeof(value)); }
+
+    /**
+     * Writes bytes that are stored in the object being serialized, which a sink may refer to rather than copy.
+     * @param data
+     * @param size
+     */
+    void writeBorrowed(const void* data, std::size_t size)
+    {
+        if (buffer != nullptr) [[likely]]
+        {
+            append(*buffer, data, size);
+        }
+        else
+        {
+            output->write_borrowed(data, size);
+        }
+    }
+
+    void writeLength(std::size_t length) { write(static_cast<int32_t>(length)); }
+
+    /**
+     * Writes a scalar to a sink, which `to_bytes()` can't append to.
+     * @tparam T
+     * @param value
+     */
+    template <typename T> void writeScalar(const T& value)
+    {
+        if constexpr (NumericRunType<T> && IntegralType<innermost_element_t<T>> && std::endian::native == std::endian::little)
+        {
+            writeBorrowed(&value, sizeof(T));
+        }
+        else if constexpr (FixedWireSize<T> && wire_size<T>() <= maxFusedFieldSize)
+        {
+            std::array<uint8_t, wire_size<T>()> bytes;
+            uint8_t*                            out = bytes.data();
+            store(value, out);
+            write(bytes.data(), bytes.size());
+        }
+        else if constexpr (FloatType<T>)
+        {
+            // long double, which has no fixed size everywhere but is the size of an integer wherever it's supported
+            if (std::isnan(value)) [[unlikely]]
+            {
+                throw std::invalid_argument("NaN is not allowed");
+            }
+            auto bits = float_to_int(value);
+            if constexpr (std::endian::native == std::endian::big)
+            {
+                bits = byteswap(bits);
+            }
+            write(&bits, sizeof(bits));
+        }
+        else if constexpr (StringType<T>)
+        {
+            writeLength(value.size());
+            writeBorrowed(value.data(), value.size());
+        }
+        else if constexpr (ScalarArrayType<T> || ScalarStdArrayType<T> || NumericRunType<T>)
+        {
+            for (const auto& item : value)
+            {
+                encode(item);
+            }
+        }
+        else
+        {
+            // an IsScalar type, whose to_bytes() only appends to a vector
+            std::vector<uint8_t> bytes;
+            to_bytes(value, bytes);
+            write(bytes.data(), bytes.size());
+        }
+    }
+
+    int32_t readLength()
+    {
+        int32_t length;
+        read(&length, sizeof(length));
+        if (length < 0) [[unlikely]]
+        {
+            throw std::invalid_argument("Invalid length");
+        }
+        return length;
     }
 
-private:
-    const SerializerDirection direction;
-    std::vector<uint8_t>&     buffer;
-    const uint8_t*&           bufferPointerReference;
+    /**
+     * Throws `incomplete_input` unless at least `size` more bytes of input are left.
+     * @param size
+     */
+    void require(std::size_t size) const
+    {
+        if (static_cast<std::size_t>(inputEnd - bufferPointerReference) < size) [[unlikely]]
+        {
+            if (segmentedInput == nullptr || segmentedInput->remaining() < size)
+            {
+                throw incomplete_input(position() + size);
+            }
+        }
+    }
 
     /**
-     * This handles the execution path for the compiler where a const variable was passed to serialize().
-     * Normally, the compiler would not have access to `direction` at compile-time, therefore trying to
-     * explore the deserialization code path and returning a variety of errors. This helps prevent that
-     * and offloads the undesirable situation to an exception.
+     * Number of bytes of input left to read.
+     */
+    std::size_t remaining() const noexcept
+    {
+        return segmentedInput != nullptr ? segmentedInput->remaining() : static_cast<std::size_t>(inputEnd - bufferPointerReference);
+    }
+
+    /**
+     * Makes sure that the next `size` bytes of input can be read right from `bufferPointerReference`. That is only
+     * ever not the case with segmented input, whose window is then moved on or stitched.
+     * @param size
+     */
+    void acquire(std::size_t size)
+    {
+        if (static_cast<std::size_t>(inputEnd - bufferPointerReference) < size) [[unlikely]]
+        {
+            if (segmentedInput == nullptr)
+            {
+                throw incomplete_input(position() + size);
+            }
+            segmentedInput->acquire(size);
+            inputEnd = segmentedInput->windowEnd;
+        }
+    }
+
+    /**
+     * How many bytes have been written or read.
+     */
+    std::size_t position() const noexcept
+    {
+        if (direction == SerializerDirection::Serialize)
+        {
+            return buffer != nullptr ? buffer->size() : output->size();
+        }
+        return segmentedInput != nullptr ? segmentedInput->consumed() : static_cast<std::size_t>(bufferPointerReference - inputStart);
+    }
+
+    /**
+     * Vectors whose elements are trivially serializable are encoded and decoded with one copy of their storage.
+     * `std::vector<bool>` is excluded since it doesn't store its elements contiguously.
+     */
+    template <typename T>
+    static constexpr bool BulkCopyable = TriviallySerializable<typename T::value_type> && !std::is_same_v<typename T::value_type, bool>;
+
+    void read(void* destination, std::size_t size)
+    {
+        // an empty vector may have no storage to copy to
+        if (size == 0)
+        {
+            return;
+        }
+
+        if (static_cast<std::size_t>(inputEnd - bufferPointerReference) >= size) [[likely]]
+        {
+            std::memcpy(destination, bufferPointerReference, size);
+            bufferPointerReference += size;
+        }
+        else if (segmentedInput != nullptr)
+        {
+            // large copies are split at the segment ends rather than stitched
+            segmentedInput->read(destination, size);
+            inputEnd = segmentedInput->windowEnd;
+        }
+        else
+        {
+            throw incomplete_input(position() + size);
+        }
+    }
+
+    /**
+     * Serializes an aggregate without a hand-written serialize() function as if it had one listing all of its fields.
      * @tparam T
      * @param value
      */
-    template <typename T> void visit(const T& value)
+    template <AggregateType T> void visitFields(T& value)
     {
-        if (direction == SerializerDirection::Serialize)
+        visit_fields(value, [this](auto&... fields) { (*this)(fields...); });
+    }
+
+    /**
+     * User provided serialize() functions take their object by non-const reference since the same function is used
+     * for both directions. While encoding the object is only ever read, so handing it a const_cast reference is safe.
+     * @tparam T
+     * @param value
+     */
+    template <typename T> void encode(const T& value)
+    {
+        // pending visits have to be written out before anything that follows them
+        if (pending.size() > pendingBase) [[unlikely]]
+        {
+            resumePending();
+        }
+
+        if constexpr (SerializableVector<T>)
         {
-            if constexpr (SerializableVector<T>)
+            writeLength(value.size());
+
+            if constexpr (BulkCopyable<T>)
+            {
+                writeBorrowed(value.data(), value.size() * sizeof(typename T::value_type));
+            }
+            else
             {
-                append(buffer, static_cast<int32_t>(value.size()));
+                encodeElements(value, 0);
+            }
+        }
+        else if constexpr (SerializableJagged<T>)
+        {
+            writeLength(value.size());
 
-                for (auto item : value)
+            for (const auto row : value)
+            {
+                if (pending.size() > pendingBase) [[unlikely]]
                 {
-                    if constexpr (SerializableNonScalar<typename T::value_type>)
-                    {
-                        serialize(item, *this);
-                    }
-                    else
+                    resumePending();
+                }
+                writeLength(row.size());
+
+                if constexpr (BulkCopyable<T>)
+                {
+                    writeBorrowed(row.data(), row.size_bytes());
+                }
+                else
+                {
+                    for (const auto& item : row)
                     {
-                        to_bytes(item, buffer);
+                        encode(item);
                     }
                 }
             }
-            else if constexpr (ScalarType<T> || ScalarArrayType<T> || ScalarStdArrayType<T>)
+        }
+        else if constexpr (OptionalType<T>)
+        {
+            write(static_cast<uint8_t>(value.has_value()));
+            if (value.has_value())
+            {
+                encode(*value);
+            }
+        }
+        else if constexpr (BoxType<T>)
+        {
+            defer(dereference(value));
+        }
+        else if constexpr (InternedType<T>)
+        {
+            encode(*value);
+        }
+        else if constexpr (SerializableMap<T>)
+        {
+            writeLength(value.size());
+
+            if constexpr (NaturallyOrderedType<T>)
             {
-                to_bytes(value, buffer);
+                for (const auto& [key, mapped] : value)
+                {
+                    encode(key);
+                    encode(mapped);
+                }
             }
             else
             {
-                serialize(value, *this);
+                for (const auto& entry : sorted_entries(value, [](const auto& item) -> const auto& { return item.first; }))
+                {
+                    const auto& [key, mapped] = *entry;
+                    encode(key);
+                    encode(mapped);
+                }
             }
         }
-        else [[unlikely]]
+        else if constexpr (SerializableSet<T>)
         {
-            throw std::runtime_error("Cannot deserialize into a const object");
+            writeLength(value.size());
+
+            if constexpr (NaturallyOrderedType<T>)
+            {
+                for (const auto& key : value)
+                {
+                    encode(key);
+                }
+            }
+            else
+            {
+                for (const auto& entry : sorted_entries(value, [](const auto& item) -> const auto& { return item; }))
+                {
+                    encode(*entry);
+                }
+            }
+        }
+        else if constexpr (ScalarType<T> || ScalarArrayType<T> || ScalarStdArrayType<T> || NumericRunType<T>)
+        {
+            if (buffer != nullptr) [[likely]]
+            {
+                to_bytes(value, *buffer);
+            }
+            else
+            {
+                writeScalar(value);
+            }
+        }
+        else if constexpr (TriviallySerializable<T>)
+        {
+            writeBorrowed(&value, sizeof(T));
+        }
+        else if constexpr (is_std_array_v<T> || is_bounded_array_v<T>)
+        {
+            for (const auto& item : value)
+            {
+                encode(item);
+            }
+        }
+        else if constexpr (AggregateType<T> && !CustomSerializable<T>)
+        {
+            visitFields(const_cast<T&>(value));
+        }
+        else
+        {
+            serialize(const_cast<T&>(value), *this);
         }
     }
 
-    template <typename T> void visit(T& value)
+    template <typename T> void decode(T& value)
     {
-        if (direction == SerializerDirection::Serialize)
+        if (pending.size() > pendingBase) [[unlikely]]
         {
-            if constexpr (SerializableVector<T>)
-            {
-                append(buffer, static_cast<int32_t>(value.size()));
+            resumePending();
+        }
+
+        if constexpr (SerializableVector<T>)
+        {
+            const int32_t length = readLength();
 
-                for (auto item : value)
+            if constexpr (BulkCopyable<T>)
+            {
+                // checked before resizing so that a corrupt length can't make it allocate
+                require(static_cast<std::size_t>(length) * sizeof(typename T::value_type));
+                value.resize(static_cast<std::size_t>(length));
+                read(value.data(), value.size() * sizeof(typename T::value_type));
+            }
+            else
+            {
+                // elements that are already there are decoded in place and keep whatever they have allocated, the rest
+                // are appended as they are read so that a corrupt length runs out of input before it allocates much
+                const auto count = static_cast<std::size_t>(length);
+                if (value.size() > count)
                 {
-                    if constexpr (SerializableNonScalar<typename T::value_type>)
+                    value.resize(count);
+                }
+                value.reserve(std::min(count, remaining()));
+                if constexpr (std::is_same_v<typename T::value_type, bool>)
+                {
+                    for (auto&& element : value)
+                    {
+                        bool item;
+                        decode(item);
+                        element = item;
+                    }
+                    while (value.size() < count)
                     {
-                        serialize(item, *this);
+                        bool item;
+                        decode(item);
+                        value.push_back(item);
                     }
-                    else
+                }
+                else
+                {
+                    decodeElements(value, 0, count);
+                }
+            }
+        }
+        else if constexpr (SerializableJagged<T>)
+        {
+            using Element = typename T::value_type;
+
+            // the lengths are checked against what is left of the input before anything is allocated for them, every
+            // row taking up at least its own length and every element at least a byte
+            constexpr std::size_t minimumElementSize = FixedWireSize<Element> ? wire_size<Element>() : 1;
+
+            const int32_t rows = readLength();
+            require(static_cast<std::size_t>(rows) * sizeof(int32_t));
+
+            value.clear();
+            value.reserve(static_cast<std::size_t>(rows), 0);
+            for (int32_t i = 0; i < rows; ++i)
+            {
+                if (pending.size() > pendingBase) [[unlikely]]
+                {
+                    resumePending();
+                }
+                const auto length = static_cast<std::size_t>(readLength());
+                require(length * minimumElementSize);
+                auto row = value.add_row(length);
+
+                if constexpr (BulkCopyable<T>)
+                {
+                    read(row.data(), row.size_bytes());
+                }
+                else
+                {
+                    for (auto& item : row)
                     {
-                        to_bytes(item, buffer);
+                        decode(item);
                     }
                 }
             }
-            else if constexpr (ScalarType<T> || ScalarArrayType<T> || ScalarStdArrayType<T>)
+        }
+        else if constexpr (OptionalType<T>)
+        {
+            if (readOptionTag())
             {
-                to_bytes(value, buffer);
+                if (!value.has_value())
+                {
+                    value.emplace();
+                }
+                decode(*value);
             }
             else
             {
-                serialize(value, *this);
+                value.reset();
             }
         }
-        else
+        else if constexpr (BoxType<T>)
+        {
+            defer(*allocate(value));
+        }
+        else if constexpr (InternedType<T>)
+        {
+            using Value = typename T::value_type;
+
+            if (internPool == nullptr) [[unlikely]]
+            {
+                throw std::runtime_error("Deserializing an interned value requires an intern_pool");
+            }
+
+            std::size_t length = 0;
+            if constexpr (StringType<Value>)
+            {
+                length = static_cast<std::size_t>(readLength());
+            }
+            else
+            {
+                length = std::tuple_size_v<Value>;
+            }
+            acquire(length);
+            // the bytes are looked up where they are, nothing is copied unless the value is new
+            value = internPool->intern<Value>(std::span<const uint8_t>(bufferPointerReference, length));
+            bufferPointerReference += length;
+        }
+        else if constexpr (SerializableMap<T> && NodeReusable<T>)
         {
-            if constexpr (SerializableVector<T>)
+            const int32_t length = readLength();
+
+            // the nodes of the old entries are decoded into and relinked instead of being freed and allocated again
+            T previous;
+            previous.swap(value);
+            if constexpr (requires { value.reserve(std::size_t{}); })
             {
-                const int32_t length = *reinterpret_cast<const int32_t*>(bufferPointerReference);
-                bufferPointerReference += sizeof(int32_t);
+                // every entry takes up at least a byte, so a corrupt length can't reserve more than the input holds
+                value.reserve(std::min(static_cast<std::size_t>(length), remaining()));
+            }
 
-                value.clear();
-                for (int32_t i = 0; i < length; ++i)
+            for (int32_t i = 0; i < length; ++i)
+            {
+                if (previous.empty())
                 {
-                    typename T::value_type element;
-                    if constexpr (SerializableNonScalar<typename T::value_type>)
-                    {
-                        serialize(element, *this);
-                    }
-                    else
-                    {
-                        from_bytes(element, bufferPointerReference);
-                    }
-                    value.push_back(element);
+                    typename T::key_type    key{};
+                    typename T::mapped_type mapped{};
+                    decode(key);
+                    decode(mapped);
+                    value.emplace_hint(value.end(), std::move(key), std::move(mapped));
+                }
+                else
+                {
+                    auto node = previous.extract(previous.begin());
+                    decode(node.key());
+                    decode(node.mapped());
+                    value.insert(value.end(), std::move(node));
+                }
+            }
+        }
+        else if constexpr (SerializableMap<T>)
+        {
+            const int32_t length = readLength();
+
+            value.clear();
+            if constexpr (requires { value.reserve(std::size_t{}); })
+            {
+                value.reserve(std::min(static_cast<std::size_t>(length), remaining()));
+            }
+
+            for (int32_t i = 0; i < length; ++i)
+            {
+                typename T::key_type    key{};
+                typename T::mapped_type mapped{};
+                decode(key);
+                decode(mapped);
+                // entries arrive in ascending key order, so an ordered map only ever appends at the end
+                value.emplace_hint(value.end(), std::move(key), std::move(mapped));
+            }
+        }
+        else if constexpr (SerializableSet<T> && NodeReusable<T>)
+        {
+            const int32_t length = readLength();
+
+            T previous;
+            previous.swap(value);
+            if constexpr (requires { value.reserve(std::size_t{}); })
+            {
+                value.reserve(std::min(static_cast<std::size_t>(length), remaining()));
+            }
+
+            for (int32_t i = 0; i < length; ++i)
+            {
+                if (previous.empty())
+                {
+                    typename T::key_type key{};
+                    decode(key);
+                    value.emplace_hint(value.end(), std::move(key));
+                }
+                else
+                {
+                    auto node = previous.extract(previous.begin());
+                    decode(node.value());
+                    value.insert(value.end(), std::move(node));
                 }
             }
-            else if constexpr (ScalarType<T> || ScalarArrayType<T> || ScalarStdArrayType<T>)
+        }
+        else if constexpr (SerializableSet<T>)
+        {
+            const int32_t length = readLength();
+
+            value.clear();
+            if constexpr (requires { value.reserve(std::size_t{}); })
+            {
+                value.reserve(std::min(static_cast<std::size_t>(length), remaining()));
+            }
+
+            for (int32_t i = 0; i < length; ++i)
+            {
+                typename T::key_type key{};
+                decode(key);
+                value.emplace_hint(value.end(), std::move(key));
+            }
+        }
+        else if constexpr (StringType<T>)
+        {
+            const auto length = static_cast<std::size_t>(readLength());
+            if (static_cast<std::size_t>(inputEnd - bufferPointerReference) >= length) [[likely]]
             {
-                from_bytes(value, bufferPointerReference);
+                // assign() keeps the capacity the string already has
+                value.assign(reinterpret_cast<const char*>(bufferPointerReference), length);
+                bufferPointerReference += length;
             }
             else
             {
-                serialize(value, *this);
+                require(length);
+                value.resize(length);
+                read(value.data(), length);
+            }
+        }
+        else if constexpr (NumericType<T> && FixedWireSize<T>)
+        {
+            // the input has no alignment, load() copies the bytes out rather than dereferencing them
+            acquire(sizeof(T));
+            load(value, bufferPointerReference);
+        }
+        else if constexpr (NumericRunType<T> && std::endian::native == std::endian::little)
+        {
+            // copied straight into the array, a run spread over several segments is split rather than stitched
+            read(&value, sizeof(T));
+            if constexpr (std::is_same_v<innermost_element_t<T>, bool>)
+            {
+                const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+                if (std::any_of(bytes, bytes + sizeof(T), [](uint8_t byte) { return byte > 1; })) [[unlikely]]
+                {
+                    // leave no invalid bools behind
+                    std::memset(&value, 0, sizeof(T));
+                    throw std::invalid_argument("Invalid bool");
+                }
+            }
+        }
+        else if constexpr (NumericType<T> || NumericRunType<T>)
+        {
+            acquire(sizeof(T));
+            from_bytes(value, bufferPointerReference);
+        }
+        else if constexpr (ScalarType<T>)
+        {
+            acquire(sizeof(T));
+            from_bytes(value, bufferPointerReference);
+        }
+        else if constexpr (TriviallySerializable<T>)
+        {
+            read(&value, sizeof(T));
+        }
+        else if constexpr (is_std_array_v<T> || is_bounded_array_v<T>)
+        {
+            for (auto& item : value)
+            {
+                decode(item);
             }
         }
+        else if constexpr (AggregateType<T> && !CustomSerializable<T>)
+        {
+            visitFields(value);
+        }
+        else
+        {
+            serialize(value, *this);
+        }
     }
 };
 
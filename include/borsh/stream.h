@@ -0,0 +1,259 @@
+#pragma once
+#ifndef BORSH_CPP20_STREAM_H
+#define BORSH_CPP20_STREAM_H
+
+#include "concepts.h"
+
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if __has_include(<unistd.h>)
+#include <cerrno>
+#include <system_error>
+#include <unistd.h>
+#endif
+
+namespace borsh
+{
+
+/**
+ * A coroutine that yields references to objects of type `T`, consumed as an input range. Each reference is valid
+ * until the iterator is advanced. Exceptions thrown by the coroutine are rethrown by whoever resumed it.
+ * @tparam T
+ */
+template <typename T> class generator
+{
+public:
+    struct promise_type
+    {
+        const T*           current = nullptr;
+        std::exception_ptr exception;
+
+        generator get_return_object() noexcept { return generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; }
+
+        std::suspend_always yield_value(const T& value) noexcept
+        {
+            current = &value;
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+    };
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        const T& operator*() const noexcept { return *coroutine.promise().current; }
+        const T* operator->() const noexcept { return coroutine.promise().current; }
+
+        iterator& operator++()
+        {
+            resume(coroutine);
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept { return it.coroutine.done(); }
+
+    private:
+        friend class generator;
+
+        std::coroutine_handle<promise_type> coroutine;
+
+        explicit iterator(std::coroutine_handle<promise_type> inCoroutine) noexcept : coroutine(inCoroutine) {}
+    };
+
+    generator(generator&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+
+    generator& operator=(generator&& other) noexcept
+    {
+        if (this != &other)
+        {
+            destroy();
+            coroutine = std::exchange(other.coroutine, nullptr);
+        }
+        return *this;
+    }
+
+    generator(const generator&) = delete;
+    generator& operator=(const generator&) = delete;
+
+    ~generator() { destroy(); }
+
+    /**
+     * Runs the coroutine up to its first object. Can only be called once.
+     */
+    iterator begin()
+    {
+        resume(coroutine);
+        return iterator(coroutine);
+    }
+
+    std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+
+private:
+    std::coroutine_handle<promise_type> coroutine;
+
+    explicit generator(std::coroutine_handle<promise_type> inCoroutine) noexcept : coroutine(inCoroutine) {}
+
+    void destroy() noexcept
+    {
+        if (coroutine)
+        {
+            coroutine.destroy();
+        }
+    }
+
+    static void resume(std::coroutine_handle<promise_type> coroutine)
+    {
+        coroutine.resume();
+        if (coroutine.promise().exception) [[unlikely]]
+        {
+            std::rethrow_exception(std::exchange(coroutine.promise().exception, nullptr));
+        }
+    }
+};
+
+/**
+ * Reads up to `size` bytes into `data`, returning how many were read, and 0 only at the end of the input.
+ */
+template <typename F>
+concept ByteReader = requires(F read, uint8_t* data, std::size_t size) {
+    {
+        read(data, size)
+    } -> std::convertible_to<std::size_t>;
+};
+
+/**
+ * Decodes the elements of a serialized `std::vector<T>` one at a time as they are read, in chunks of `chunkSize`
+ * bytes, so that only one element and the bytes read ahead of it are in memory at any time. An element that doesn't
+ * fit in what's left of the buffer is decoded again once at least as many bytes are in as it was found to need, so a
+ * large element is only retried when a field it is missing has arrived, however short the reads. The buffer only grows
+ * for an element larger than all of it. Every element is decoded into the same object. Reading stops after the last
+ * element, input that ends before it throws `incomplete_input`.
+ * @tparam T
+ * @param read
+ * @param chunkSize
+ * @return
+ */
+template <Serializable T, ByteReader Reader> generator<T> stream_vector(Reader read, std::size_t chunkSize = 64 * 1024)
+{
+    std::vector<uint8_t> buffer(chunkSize < sizeof(int32_t) ? sizeof(int32_t) : chunkSize);
+    std::size_t          begin = 0;
+    std::size_t          end = 0;
+
+    // moves the unread bytes to the front, then reads after them until at least `size` of them are in, returns false
+    // if the input ends first
+    const auto fill = [&](std::size_t size) -> bool {
+        if (begin > 0)
+        {
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+
+        // grown as the bytes come in rather than to `size` up front, which may come from a corrupt length
+        while (end < size)
+        {
+            if (end == buffer.size())
+            {
+                buffer.resize(buffer.size() * 2);
+            }
+            const std::size_t count = read(buffer.data() + end, buffer.size() - end);
+            if (count == 0)
+            {
+                return false;
+            }
+            end += count;
+        }
+        return true;
+    };
+
+    const auto decode = [&](auto& value) {
+        while (true)
+        {
+            try
+            {
+                begin += deserialize_into(value, std::span<const uint8_t>(buffer.data() + begin, end - begin));
+                return;
+            }
+            catch (const incomplete_input& error)
+            {
+                // only running out of input is retried, anything else the payload is wrong about is not
+                if (!fill(error.needed()))
+                {
+                    throw;
+                }
+            }
+        }
+    };
+
+    int32_t length = 0;
+    decode(length);
+    if (length < 0) [[unlikely]]
+    {
+        throw std::invalid_argument("Invalid length");
+    }
+
+    T current{};
+    for (int32_t i = 0; i < length; ++i)
+    {
+        decode(current);
+        co_yield current;
+    }
+}
+
+#if __has_include(<unistd.h>)
+/**
+ * Decodes the elements of a serialized `std::vector<T>` read from the file descriptor `fd`, which stays open.
+ * Read errors throw `std::system_error`.
+ * @tparam T
+ * @param fd
+ * @param chunkSize
+ * @return
+ */
+template <Serializable T> generator<T> stream_vector(int fd, std::size_t chunkSize = 64 * 1024)
+{
+    return stream_vector<T>(
+        [fd](uint8_t* data, std::size_t size) -> std::size_t {
+            while (true)
+            {
+                const ssize_t count = ::read(fd, data, size);
+                if (count >= 0)
+                {
+                    return static_cast<std::size_t>(count);
+                }
+                if (errno != EINTR)
+                {
+                    throw std::system_error(errno, std::generic_category(), "read");
+                }
+            }
+        },
+        chunkSize);
+}
+#endif
+
+} // namespace borsh
+
+#endif
@@ -20,11 +20,14 @@
 #define BORSH_CPP20_TEMPLATES_H
 
 #include "concepts.h"
+#include "reflection.h"
 
 #include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstring>
 #include <memory>
+#include <span>
 #include <vector>
 #include <type_traits>
 #include <string>
@@ -35,6 +38,8 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <tuple>
+#include <utility>
 
 namespace borsh
 {
@@ -54,6 +59,46 @@ auto serialize(SerializableVector auto& value, Serializer& serializer)
     return serializer(value);
 }
 
+auto serialize(SerializableMap auto& value, Serializer& serializer)
+{
+    return serializer(value);
+}
+
+auto serialize(SerializableSet auto& value, Serializer& serializer)
+{
+    return serializer(value);
+}
+
+auto serialize(SerializableJagged auto& value, Serializer& serializer)
+{
+    return serializer(value);
+}
+
+auto serialize(OptionalType auto& value, Serializer& serializer)
+{
+    return serializer(value);
+}
+
+auto serialize(BoxType auto& value, Serializer& serializer)
+{
+    return serializer(value);
+}
+
+auto serialize(InternedType auto& value, Serializer& serializer)
+{
+    return serializer(value);
+}
+
+template <typename... Ts> auto serialize(std::tuple<Ts...>& value, Serializer& serializer)
+{
+    return std::apply([&serializer](auto&... items) -> Serializer& { return serializer(items...); }, value);
+}
+
+template <typename A, typename B> auto serialize(std::pair<A, B>& value, Serializer& serializer)
+{
+    return serializer(value.first, value.second);
+}
+
 template <typename T, std::size_t N>
 auto serialize(std::array<T, N>& value, Serializer& serializer)
     requires Serializable<T>
@@ -62,7 +107,7 @@ auto serialize(std::array<T, N>& value, Serializer& serializer)
 }
 
 template <typename T>
-    requires ScalarType<T> || ScalarArrayType<T> || ScalarStdArrayType<T>
+    requires ScalarType<T> || ScalarArrayType<T> || ScalarStdArrayType<T> || NumericRunType<T>
 std::vector<uint8_t> serialize(const T& value)
 {
     std::vector<uint8_t> buffer;
@@ -70,12 +115,67 @@ std::vector<uint8_t> serialize(const T& value)
     return buffer;
 }
 
+/**
+ * How large the encodings of a type opted into `IsCapacityLearned` tend to get: an exponentially weighted maximum of
+ * the sizes recently serialized, which jumps to any larger size right away and decays by an eighth per smaller one.
+ * It is shared by all threads and updated without locks.
+ * @tparam T
+ */
+template <typename T> class capacity_hint
+{
+public:
+    /**
+     * The number of bytes reserved up front for the next encoding.
+     */
+    static std::size_t get() noexcept { return predicted.load(std::memory_order_relaxed); }
+
+    static void observe(std::size_t size) noexcept
+    {
+        std::size_t current = predicted.load(std::memory_order_relaxed);
+        std::size_t next;
+        do
+        {
+            next = std::max(size, current - current / 8);
+        } while (next != current && !predicted.compare_exchange_weak(current, next, std::memory_order_relaxed));
+    }
+
+    static void reset() noexcept { predicted.store(0, std::memory_order_relaxed); }
+
+private:
+    inline static std::atomic<std::size_t> predicted{ 0 };
+};
+
+/**
+ * How many bytes to reserve for encoding a `T`: exactly its size if that is fixed, what `capacity_hint` predicts if
+ * it is opted into learning, or nothing.
+ */
+template <typename T> std::size_t expected_size() noexcept
+{
+    if constexpr (FixedWireSize<T>)
+    {
+        return wire_size<std::remove_cv_t<T>>();
+    }
+    else if constexpr (CapacityLearned<T>)
+    {
+        return capacity_hint<std::remove_cv_t<T>>::get();
+    }
+    else
+    {
+        return 0;
+    }
+}
+
 template <SerializableNonScalar T> std::vector<uint8_t> serialize(T& object)
 {
     std::vector<uint8_t> buffer;
-    const uint8_t*       data = buffer.data();
-    Serializer           serializer(buffer, data, SerializerDirection::Serialize);
-    serialize(object, serializer);
+    buffer.reserve(expected_size<T>());
+    const uint8_t* data = buffer.data();
+    Serializer     serializer(buffer, data, SerializerDirection::Serialize);
+    serializer(object);
+    if constexpr (CapacityLearned<T>)
+    {
+        capacity_hint<std::remove_cv_t<T>>::observe(buffer.size());
+    }
     return buffer;
 }
 
@@ -88,37 +188,193 @@ std::vector<uint8_t> serialize(SerializableNonScalarArray auto (&array)[])
     return buffer;
 }
 
+/**
+ * Serializes an object to `output`, after whatever was written to it before.
+ * @tparam T
+ * @tparam Output
+ * @param object
+ * @param output
+ * @return The number of bytes written
+ */
+template <typename T, typename Output>
+    requires std::derived_from<Output, sink> && Serializable<T>
+std::size_t serialize(const T& object, Output& output)
+{
+    const std::size_t start = output.size();
+    Serializer        serializer(output);
+    serializer(object);
+    return output.size() - start;
+}
+
+/**
+ * Serializes an object into `out`, memory owned by the caller, such as a stack buffer or a slot of shared memory.
+ * Nothing is allocated, unless the object has unordered containers, whose entries are sorted through a temporary
+ * index, or `IsScalar` types, whose `to_bytes()` writes to a temporary vector. Invalid values, such as NaN, still throw.
+ * @tparam T
+ * @param out
+ * @param object
+ * @return The number of bytes written, or nothing if the encoding doesn't fit, in which case the contents of `out`
+ * are unspecified
+ */
+template <Serializable T> std::optional<std::size_t> serialize_to(std::span<uint8_t> out, const T& object)
+{
+    span_output output(out);
+    serialize(object, output);
+    if (output.overflowed())
+    {
+        return std::nullopt;
+    }
+    return output.size();
+}
+
+/**
+ * Serializes an object into inline storage of `N` bytes, without allocating unless the encoding turns out larger.
+ * @tparam N
+ * @tparam T
+ * @param object
+ * @return
+ */
+template <std::size_t N = 256, Serializable T> small_buffer<N> serialize_small(const T& object)
+{
+    small_buffer<N> output;
+    serialize(object, output);
+    return output;
+}
+
+/**
+ * Creates an object and has `decode` fill it in. Types that are fully decoded are only default-initialized, so
+ * that large fixed size members aren't zeroed just to be overwritten.
+ * @tparam T
+ * @param decode
+ * @return
+ */
+template <typename T, typename Decode> T decode_new(Decode&& decode)
+{
+    if constexpr (FullyDecoded<T>)
+    {
+        T object;
+        decode(object);
+        return object;
+    }
+    else
+    {
+        auto object = T{};
+        decode(object);
+        return object;
+    }
+}
+
+/**
+ * Deserializes into an existing object from the start of `input`, overwriting it. Elements that are already there are
+ * decoded in place, so strings, vectors and nodes keep the memory they own and only grow when the new value needs
+ * more. Decoding the same type over and over into one object stops allocating once it has seen the largest message.
+ * Reading past the end of `input` throws `incomplete_input`, bytes left after the object are not looked at.
+ * @tparam T
+ * @tparam Resources
+ * @param object
+ * @param input
+ * @param resources
+ * @return The number of bytes the object took up
+ */
+template <Serializable T, typename... Resources>
+std::size_t deserialize_into(T& object, std::span<const uint8_t> input, Resources&... resources)
+{
+    const uint8_t* data = input.data();
+    Serializer     serializer(data, input.data() + input.size());
+    (serializer.with(resources), ...);
+    serializer(object);
+    return static_cast<std::size_t>(data - input.data());
+}
+
+template <Serializable T, typename... Resources>
+std::size_t deserialize_into(T& object, const std::vector<uint8_t>& buffer, Resources&... resources)
+{
+    return deserialize_into(object, std::span<const uint8_t>(buffer), resources...);
+}
+
+/**
+ * Deserializes into an existing object from segmented input, starting where the previous object read from it ended.
+ * @tparam T
+ * @tparam Resources
+ * @param object
+ * @param input
+ * @param resources
+ * @return The number of bytes the object took up
+ */
+template <Serializable T, typename... Resources> std::size_t deserialize_into(T& object, segmented_input& input, Resources&... resources)
+{
+    const std::size_t start = input.consumed();
+    Serializer        serializer(input);
+    (serializer.with(resources), ...);
+    serializer(object);
+    return input.consumed() - start;
+}
+
+/**
+ * Deserializes the next object of segmented input, without copying the segments into one buffer first.
+ * @tparam T
+ * @tparam Resources
+ * @param input
+ * @param resources
+ * @return
+ */
+template <Serializable T, typename... Resources> T deserialize(segmented_input& input, Resources&... resources)
+{
+    return decode_new<T>([&](T& object) { deserialize_into(object, input, resources...); });
+}
+
+/**
+ * Deserializes an object that has to take up all of `input`, like `try_from_slice()` in Rust. Throws
+ * `std::invalid_argument` if any bytes are left over.
+ * @tparam T
+ * @tparam Resources
+ * @param input
+ * @param resources
+ * @return
+ */
+template <Serializable T, typename... Resources> T try_from_slice(std::span<const uint8_t> input, Resources&... resources)
+{
+    return decode_new<T>([&](T& object) {
+        if (deserialize_into(object, input, resources...) != input.size()) [[unlikely]]
+        {
+            throw std::invalid_argument("Not all bytes read");
+        }
+    });
+}
+
 template <typename T>
     requires ScalarType<T>
 T deserialize(std::vector<uint8_t>& buffer)
 {
-    const uint8_t* data = buffer.data();
-    T              value;
-    from_bytes(value, data);
+    T value;
+    deserialize_into(value, buffer);
     return value;
 }
 
 template <typename T, std::size_t N>
-    requires ScalarType<T>
+    requires ScalarType<T> || ScalarArrayType<T>
 void deserialize(T (&value)[N], std::vector<uint8_t>& buffer)
 {
-    const uint8_t* data = buffer.data();
-    from_bytes(value, data);
+    deserialize_into(value, buffer);
 }
 
-template <SerializableNonScalar T> T deserialize(std::vector<uint8_t>& buffer)
+/**
+ * Deserializes an object. Any memory resource passed in `resources` is used to allocate the nodes of `arena_ptr`s.
+ * @tparam T
+ * @tparam Resources
+ * @param buffer
+ * @param resources
+ * @return
+ */
+template <SerializableNonScalar T, typename... Resources> T deserialize(std::vector<uint8_t>& buffer, Resources&... resources)
 {
-    const uint8_t* data = buffer.data();
-    auto           object = T{};
-    Serializer     serializer(buffer, data, SerializerDirection::Deserialize);
-    serialize(object, serializer);
-    return object;
+    return decode_new<T>([&](T& object) { deserialize_into(object, buffer, resources...); });
 }
 
 void deserialize(SerializableNonScalarArray auto (&value)[], std::vector<uint8_t>& buffer)
 {
     const uint8_t* data = buffer.data();
-    Serializer     serializer(buffer, data, SerializerDirection::Deserialize);
+    Serializer     serializer(data, buffer.data() + buffer.size());
     serialize(value, serializer);
 }
 
@@ -75,6 +75,149 @@ template <typename T> static void append(std::vector<uint8_t>& buffer, const T&
     buffer.insert(buffer.end(), begin, end);
 }
 
+static void append(std::vector<uint8_t>& buffer, const void* data, std::size_t size)
+{
+    const auto* begin = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), begin, begin + size);
+}
+
+/**
+ * A fast, non-cryptographic hash of a run of bytes, mixing eight bytes at a time.
+ * @param data
+ * @param size
+ * @return
+ */
+static std::size_t hash_bytes(const void* data, std::size_t size) noexcept
+{
+    constexpr uint64_t multiplier = 0x9e3779b97f4a7c15ull;
+
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t    hash = size * multiplier;
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        hash = std::rotl((hash ^ word) * multiplier, 31);
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes, size);
+    hash = (hash ^ tail) * multiplier;
+
+    // the finalizer of MurmurHash3, so that every input bit affects every output bit
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return static_cast<std::size_t>(hash);
+}
+
+/**
+ * Maps an integral key onto an unsigned integer of the same width whose natural order matches the order of the key,
+ * so that keys can be radix sorted by their bit pattern.
+ */
+template <typename K> constexpr auto radix_key(K key) noexcept
+{
+    if constexpr (std::is_same_v<K, bool>)
+    {
+        return static_cast<uint8_t>(key);
+    }
+    else
+    {
+        using U = std::make_unsigned_t<K>;
+        if constexpr (std::is_signed_v<K>)
+        {
+            return static_cast<U>(static_cast<U>(key) ^ (U{ 1 } << (sizeof(U) * 8 - 1)));
+        }
+        else
+        {
+            return static_cast<U>(key);
+        }
+    }
+}
+
+/**
+ * Returns iterators to the entries of a container in ascending key order, which is the order borsh requires for maps
+ * and sets. Entries are never copied: integral keys are LSD radix sorted on their bit pattern, every other key type
+ * is sorted by comparing the keys the iterators refer to.
+ * @tparam Container
+ * @tparam KeyOf
+ * @param container
+ * @param keyOf projection from an entry to its key
+ * @return
+ */
+template <typename Container, typename KeyOf>
+auto sorted_entries(const Container& container, KeyOf keyOf) -> std::vector<typename Container::const_iterator>
+{
+    using Entry = typename Container::const_iterator;
+    using Key = std::remove_cvref_t<decltype(keyOf(*std::declval<Entry>()))>;
+
+    std::vector<Entry> entries;
+    entries.reserve(container.size());
+
+    constexpr std::size_t radixThreshold = 256;
+
+    if constexpr (std::is_integral_v<Key>)
+    {
+        if (container.size() >= radixThreshold)
+        {
+            using Digits = decltype(radix_key(std::declval<Key>()));
+            using Item = std::pair<Digits, Entry>;
+
+            std::vector<Item> items;
+            std::vector<Item> scratch(container.size());
+            items.reserve(container.size());
+
+            std::array<std::array<std::size_t, 256>, sizeof(Digits)> histograms{};
+            for (auto entry = container.begin(); entry != container.end(); ++entry)
+            {
+                const auto digits = radix_key(keyOf(*entry));
+                items.emplace_back(digits, entry);
+                for (std::size_t pass = 0; pass < sizeof(Digits); ++pass)
+                {
+                    ++histograms[pass][static_cast<uint8_t>(digits >> (pass * 8))];
+                }
+            }
+
+            for (std::size_t pass = 0; pass < sizeof(Digits); ++pass)
+            {
+                auto& histogram = histograms[pass];
+                // every key shares this digit, so the pass would not move anything
+                if (std::ranges::find(histogram, items.size()) != histogram.end())
+                {
+                    continue;
+                }
+
+                std::size_t offset = 0;
+                for (auto& count : histogram)
+                {
+                    offset += std::exchange(count, offset);
+                }
+
+                for (const auto& item : items)
+                {
+                    scratch[histogram[static_cast<uint8_t>(item.first >> (pass * 8))]++] = item;
+                }
+                items.swap(scratch);
+            }
+
+            for (const auto& item : items)
+            {
+                entries.push_back(item.second);
+            }
+            return entries;
+        }
+    }
+
+    for (auto entry = container.begin(); entry != container.end(); ++entry)
+    {
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(), entries.end(), [&keyOf](const Entry& a, const Entry& b) { return keyOf(*a) < keyOf(*b); });
+    return entries;
+}
+
 } // namespace borsh
 
 #endif
\ No newline at end of file
@@ -1,11 +1,25 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <string>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "borsh.h"
 
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+
 struct Vector2D
 {
     int32_t x;
@@ -25,6 +39,163 @@ struct Box
     std::string name;
 };
 
+// the following types have no serialize() function and are serialized field by field automatically
+struct Account
+{
+    uint64_t             lamports;
+    std::string          owner;
+    std::vector<uint8_t> data;
+    bool                 executable;
+};
+
+struct Transfer
+{
+    Vector2D                        position;
+    Account                         from;
+    std::pair<int32_t, std::string> memo;
+    std::tuple<uint8_t, int64_t>    fee;
+};
+
+struct Unit
+{
+};
+
+// no padding and only integers, so encoded with a single copy
+struct PriceLevel
+{
+    int64_t  price;
+    uint64_t quantity;
+    uint32_t orders;
+    uint8_t                side;
+    std::array<uint8_t, 3> flags;
+};
+
+struct Padded
+{
+    uint8_t  tag;
+    uint32_t value;
+};
+
+// no padding, but a bool has to be checked when it is read
+struct Flags
+{
+    bool    active;
+    uint8_t level;
+};
+
+// has a serialize() function, but opts into the bulk copy explicitly
+struct Tick
+{
+    uint32_t sequence;
+    int32_t  delta;
+};
+
+template <> struct borsh::IsTriviallySerializable<Tick> : std::true_type
+{
+};
+
+template <> struct borsh::IsCapacityLearned<Account> : std::true_type
+{
+};
+
+struct Frame
+{
+    uint32_t                      sequence;
+    std::array<uint8_t, 1 << 16>  payload;
+    std::string                   source;
+};
+
+struct Quote
+{
+    Padded   bid;
+    Padded   ask;
+    double   mid;
+    uint16_t venue;
+};
+
+struct Position
+{
+    std::array<uint8_t, 32> owner;
+    std::string             symbol;
+    uint64_t                amount;
+};
+
+// the same wire format as Position, with the repeated fields interned
+struct Holding
+{
+    borsh::interned<std::array<uint8_t, 32>> owner;
+    borsh::interned<std::string>             symbol;
+    uint64_t                                 amount;
+};
+
+struct ListNode
+{
+    uint32_t                                 value;
+    std::optional<std::unique_ptr<ListNode>> next;
+};
+
+struct TreeNode
+{
+    int64_t                         key;
+    std::optional<borsh::arena_ptr<TreeNode>> left;
+    std::optional<borsh::arena_ptr<TreeNode>> right;
+};
+
+struct Branch
+{
+    uint32_t                             value;
+    std::vector<std::unique_ptr<Branch>> children;
+};
+
+struct Fork
+{
+    std::array<std::optional<std::unique_ptr<Fork>>, 2> branches;
+};
+
+struct Expression
+{
+    std::string                                name;
+    std::optional<std::shared_ptr<Expression>> operand;
+};
+
+class Celsius
+{
+public:
+    Celsius() = default;
+    explicit Celsius(int32_t inHundredths) : hundredths(inHundredths) {}
+
+    int32_t hundredths = 0;
+};
+
+template <> struct borsh::IsScalar<Celsius> : std::true_type
+{
+};
+
+auto serialize(ListNode& data, borsh::Serializer& serializer)
+{
+    return serializer(data.value, data.next);
+}
+
+auto serialize(TreeNode& data, borsh::Serializer& serializer)
+{
+    return serializer(data.key, data.left, data.right);
+}
+
+auto serialize(Branch& data, borsh::Serializer& serializer)
+{
+    return serializer(data.value, data.children);
+}
+
+auto serialize(Fork& data, borsh::Serializer& serializer)
+{
+    return serializer(data.branches);
+}
+
+auto serialize(Expression& data, borsh::Serializer& serializer)
+{
+    return serializer(data.name, data.operand);
+}
+
 auto serialize(Vector2D& data, borsh::Serializer& serializer)
 {
     return serializer(data.x, data.y);
@@ -40,6 +211,22 @@ auto serialize(Box& data, borsh::Serializer& serializer)
     return serializer(data.dimensions, data.name);
 }
 
+auto serialize(Tick& data, borsh::Serializer& serializer)
+{
+    return serializer(data.sequence, data.delta);
+}
+
+void to_bytes(const Celsius& value, std::vector<uint8_t>& buffer)
+{
+    borsh::to_bytes(value.hundredths, buffer);
+}
+
+void from_bytes(Celsius& value, const uint8_t*& buffer)
+{
+    std::memcpy(&value.hundredths, buffer, sizeof(value.hundredths));
+    buffer += sizeof(value.hundredths);
+}
+
 int main()
 {
     using namespace boost::ut;
@@ -406,5 +593,1204 @@ int main()
             expect(eq(deserializedVector.at(1).b.x, 45) and eq(deserializedVector.at(1).b.y, 75));
             expect(eq(deserializedVector.at(1).name, std::string("olleh 🚀")));
         };
+
+        "map"_test = [] {
+            static_assert(Serializable<std::map<std::string, uint64_t>>);
+            static_assert(Serializable<std::unordered_map<int32_t, Vector2D>>);
+
+            const std::unordered_map<std::string, uint16_t> map = { { "b", 2 }, { "a", 1 }, { "ab", 3 } };
+
+            auto serializedMap = serialize(map);
+            expect(eq(serializedMap,
+                std::vector<uint8_t>{ //
+                    // number of entries
+                    3, 0, 0, 0,
+                    // entries sorted by key: "a", "ab", "b"
+                    1, 0, 0, 0, 'a', 1, 0,        //
+                    2, 0, 0, 0, 'a', 'b', 3, 0,   //
+                    1, 0, 0, 0, 'b', 2, 0 }));
+
+            const std::map<std::string, uint16_t> ordered(map.begin(), map.end());
+            expect(eq(serialize(ordered), serializedMap));
+
+            auto deserializedMap = deserialize<std::unordered_map<std::string, uint16_t>>(serializedMap);
+            expect(deserializedMap == map);
+            auto deserializedOrdered = deserialize<std::map<std::string, uint16_t>>(serializedMap);
+            expect(deserializedOrdered == ordered);
+        };
+
+        "map with integral keys"_test = [] {
+            std::unordered_map<int64_t, Vector2D> map;
+            for (int32_t i = -500; i < 500; ++i)
+            {
+                map.emplace(static_cast<int64_t>(i) * 7919, Vector2D{ i, -i });
+            }
+
+            std::map<int64_t, Vector2D, std::less<>> ordered;
+            for (const auto& [key, value] : map)
+            {
+                ordered.emplace(key, value);
+            }
+
+            auto serializedMap = serialize(map);
+            expect(eq(serializedMap.size(), sizeof(int32_t) + map.size() * (sizeof(int64_t) + sizeof(Vector2D))));
+            expect(eq(serialize(ordered), serializedMap));
+
+            auto deserializedMap = deserialize<std::map<int64_t, Vector2D, std::less<>>>(serializedMap);
+            expect(eq(deserializedMap.size(), map.size()));
+            expect(eq(deserializedMap.begin()->first, static_cast<int64_t>(-500) * 7919));
+            expect(eq(deserializedMap.at(7919).x, 1) and eq(deserializedMap.at(7919).y, -1));
+        };
+
+        "set"_test = [] {
+            static_assert(Serializable<std::set<int32_t>>);
+            static_assert(Serializable<std::unordered_set<std::string>>);
+
+            const std::unordered_set<int32_t> set = { 3, -1, 2 };
+
+            auto serializedSet = serialize(set);
+            expect(eq(serializedSet,
+                std::vector<uint8_t>{ //
+                    3, 0, 0, 0,             //
+                    0xff, 0xff, 0xff, 0xff, //
+                    2, 0, 0, 0,             //
+                    3, 0, 0, 0 }));
+            const std::set<int32_t> ordered(set.begin(), set.end());
+            expect(eq(serialize(ordered), serializedSet));
+
+            std::unordered_set<uint32_t> large;
+            for (uint32_t i = 0; i < 1000; ++i)
+            {
+                large.insert(i * 2654435761u);
+            }
+            const std::set<uint32_t> largeOrdered(large.begin(), large.end());
+            auto serializedLarge = serialize(large);
+            expect(eq(serializedLarge, serialize(largeOrdered)));
+
+            auto deserializedSet = deserialize<std::unordered_set<int32_t>>(serializedSet);
+            expect(deserializedSet == set);
+            auto deserializedLarge = deserialize<std::set<uint32_t>>(serializedLarge);
+            expect(deserializedLarge == largeOrdered);
+        };
+
+        "flat_map"_test = [] {
+            static_assert(Serializable<flat_map<std::string, uint64_t>>);
+            static_assert(Serializable<flat_set<int32_t>>);
+
+            const std::map<std::string, uint64_t> map = { { "carol", 30 }, { "alice", 10 }, { "bob", 20 } };
+
+            auto serializedMap = serialize(map);
+            auto deserializedMap = deserialize<flat_map<std::string, uint64_t>>(serializedMap);
+            expect(eq(deserializedMap.size(), map.size()));
+            expect(deserializedMap.keys() == std::vector<std::string>{ "alice", "bob", "carol" });
+            expect(deserializedMap.values() == std::vector<uint64_t>{ 10, 20, 30 });
+            expect(eq(deserializedMap.at("bob"), 20ull));
+            expect(deserializedMap.find("dave") == deserializedMap.end());
+            expect(eq(serialize(deserializedMap), serializedMap));
+
+            const flat_map<int32_t, std::string, std::greater<>> reversed = { { 1, "one" }, { 3, "three" }, { 2, "two" } };
+            expect(eq((*reversed.begin()).first, 3));
+            const std::map<int32_t, std::string> canonical = { { 1, "one" }, { 2, "two" }, { 3, "three" } };
+            expect(eq(serialize(reversed), serialize(canonical)));
+
+            const std::set<int32_t> set = { 5, -7, 12 };
+            auto serializedSet = serialize(set);
+            auto deserializedSet = deserialize<flat_set<int32_t>>(serializedSet);
+            expect(deserializedSet.keys() == std::vector<int32_t>{ -7, 5, 12 });
+            expect(deserializedSet.contains(12) and not deserializedSet.contains(6));
+            expect(eq(serialize(deserializedSet), serializedSet));
+        };
+
+        "tuple and pair"_test = [] {
+            static_assert(Serializable<std::pair<int32_t, std::string>>);
+            static_assert(Serializable<std::tuple<uint8_t, Vector2D, std::vector<int16_t>>>);
+
+            std::tuple<uint8_t, int16_t, std::string> tuple{ 7, -2, "hi" };
+            auto serializedTuple = serialize(tuple);
+            expect(eq(serializedTuple, std::vector<uint8_t>{ 7, 0xfe, 0xff, 2, 0, 0, 0, 'h', 'i' }));
+            expect(deserialize<std::tuple<uint8_t, int16_t, std::string>>(serializedTuple) == tuple);
+
+            std::pair<int32_t, Vector2D> pair{ 1, { 2, 3 } };
+            auto serializedPair = serialize(pair);
+            expect(eq(serializedPair, std::vector<uint8_t>{ 1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0 }));
+            auto deserializedPair = deserialize<std::pair<int32_t, Vector2D>>(serializedPair);
+            expect(eq(deserializedPair.first, 1) and eq(deserializedPair.second.x, 2) and eq(deserializedPair.second.y, 3));
+        };
+
+        "aggregate without serialize()"_test = [] {
+            static_assert(field_count_v<Account> == 4);
+            static_assert(field_count_v<Transfer> == 4);
+            static_assert(field_count_v<Unit> == 0);
+            static_assert(Serializable<Account>);
+            static_assert(Serializable<std::vector<Transfer>>);
+
+            Account account{ 42, "owner", { 1, 2, 3 }, true };
+            auto    serializedAccount = serialize(account);
+            expect(eq(serializedAccount,
+                std::vector<uint8_t>{ //
+                    42, 0, 0, 0, 0, 0, 0, 0,             //
+                    5, 0, 0, 0, 'o', 'w', 'n', 'e', 'r', //
+                    3, 0, 0, 0, 1, 2, 3,                 //
+                    1 }));
+
+            auto deserializedAccount = deserialize<Account>(serializedAccount);
+            expect(eq(deserializedAccount.lamports, 42ull) and eq(deserializedAccount.owner, std::string("owner")));
+            expect(deserializedAccount.data == std::vector<uint8_t>{ 1, 2, 3 } and deserializedAccount.executable);
+
+            Transfer transfer{ { 1, 2 }, account, { -1, "memo" }, { 9, 1000 } };
+            auto     serializedTransfer = serialize(transfer);
+            expect(eq(serializedTransfer.size(), sizeof(Vector2D) + serializedAccount.size() + 12 + 9));
+
+            auto deserializedTransfer = deserialize<Transfer>(serializedTransfer);
+            expect(eq(deserializedTransfer.position.y, 2) and eq(deserializedTransfer.from.owner, std::string("owner")));
+            expect(eq(deserializedTransfer.memo.second, std::string("memo")) and eq(std::get<1>(deserializedTransfer.fee), 1000ll));
+
+            Unit unit;
+            expect(serialize(unit).empty());
+        };
+
+        "trivially serializable structs"_test = [] {
+            static_assert(TriviallySerializable<PriceLevel>);
+            static_assert(TriviallySerializable<std::array<PriceLevel, 4>>);
+            static_assert(TriviallySerializable<Tick>);
+            static_assert(!TriviallySerializable<Padded>);
+            static_assert(!TriviallySerializable<Vector2D>);
+            static_assert(!TriviallySerializable<Account>);
+            static_assert(!TriviallySerializable<float>);
+            static_assert(!TriviallySerializable<bool>);
+            static_assert(!TriviallySerializable<Flags>);
+
+            PriceLevel level{ -5, 100, 3, 1, { 7, 8, 9 } };
+            auto       serializedLevel = serialize(level);
+            expect(eq(serializedLevel,
+                std::vector<uint8_t>{ //
+                    0xfb, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, //
+                    100, 0, 0, 0, 0, 0, 0, 0,                       //
+                    3, 0, 0, 0,                                     //
+                    1, 7, 8, 9 }));
+
+            std::vector<PriceLevel> levels;
+            for (int64_t i = 0; i < 100; ++i)
+            {
+                levels.push_back({ i, static_cast<uint64_t>(i * 10), static_cast<uint32_t>(i), static_cast<uint8_t>(i % 2), { 1, 2, 3 } });
+            }
+
+            auto serializedLevels = serialize(levels);
+            expect(eq(serializedLevels.size(), sizeof(int32_t) + levels.size() * sizeof(PriceLevel)));
+
+            auto deserializedLevels = deserialize<std::vector<PriceLevel>>(serializedLevels);
+            expect(eq(deserializedLevels.size(), levels.size()));
+            expect(eq(deserializedLevels.at(42).price, 42ll) and eq(deserializedLevels.at(42).quantity, 420ull));
+            expect(eq(deserializedLevels.at(99).flags.at(2), 3));
+
+            Padded padded{ 1, 2 };
+            expect(eq(serialize(padded), std::vector<uint8_t>{ 1, 2, 0, 0, 0 }));
+
+            std::vector<Tick> ticks = { { 1, -1 }, { 2, -2 } };
+            auto serializedTicks = serialize(ticks);
+            expect(eq(serializedTicks, std::vector<uint8_t>{ 2, 0, 0, 0, 1, 0, 0, 0, 0xff, 0xff, 0xff, 0xff, 2, 0, 0, 0, 0xfe, 0xff, 0xff, 0xff }));
+            auto deserializedTicks = deserialize<std::vector<Tick>>(serializedTicks);
+            expect(eq(deserializedTicks.at(1).delta, -2));
+
+            std::vector<bool> flags = { true, false, true };
+            auto serializedFlags = serialize(flags);
+            expect(eq(serializedFlags, std::vector<uint8_t>{ 3, 0, 0, 0, 1, 0, 1 }));
+            expect(deserialize<std::vector<bool>>(serializedFlags) == flags);
+
+            // bytes other than 0 and 1 are no bools, wherever they are
+            std::vector<uint8_t> invalidFlags = { 2, 7 };
+            expect(throws<std::invalid_argument>([&] { deserialize<Flags>(invalidFlags); }));
+            expect(throws<std::invalid_argument>([&] { deserialize<std::array<bool, 2>>(invalidFlags); }));
+            std::vector<uint8_t> invalidFlagVector = { 2, 0, 0, 0, 1, 2 };
+            expect(throws<std::invalid_argument>([&] { deserialize<std::vector<bool>>(invalidFlagVector); }));
+            std::vector<uint8_t> invalidFlagsVector = { 1, 0, 0, 0, 2, 7 };
+            expect(throws<std::invalid_argument>([&] { deserialize<std::vector<Flags>>(invalidFlagsVector); }));
+            std::vector<uint8_t> validFlags = { 1, 7 };
+            expect(eq(deserialize<Flags>(validFlags).active, true) and eq(deserialize<Flags>(validFlags).level, 7));
+
+            std::vector<uint8_t> noLevels = { 0, 0, 0, 0 };
+            expect(deserialize<std::vector<PriceLevel>>(noLevels).empty());
+        };
+
+        "jagged"_test = [] {
+            static_assert(Serializable<jagged<uint64_t>>);
+            static_assert(Serializable<jagged<std::string>>);
+
+            const std::vector<std::vector<uint64_t>> nested = { { 1, 2, 3 }, {}, { 4 } };
+            auto serializedNested = serialize(nested);
+
+            auto deserialized = deserialize<jagged<uint64_t>>(serializedNested);
+            expect(eq(deserialized.size(), static_cast<size_t>(3)));
+            expect(deserialized.values() == std::vector<uint64_t>{ 1, 2, 3, 4 });
+            expect(deserialized.offsets() == std::vector<size_t>{ 0, 3, 3, 4 });
+            expect(deserialized[1].empty() and eq(deserialized[2][0], 4ull));
+            expect(eq(serialize(deserialized), serializedNested));
+
+            jagged<std::string> names = { { "a", "bc" }, { "def" } };
+            auto                serializedNames = serialize(names);
+            const std::vector<std::vector<std::string>> nestedNames = { { "a", "bc" }, { "def" } };
+            expect(eq(serializedNames, serialize(nestedNames)));
+
+            auto deserializedNames = deserialize<jagged<std::string>>(serializedNames);
+            expect(deserializedNames.values() == names.values() and deserializedNames.offsets() == names.offsets());
+            expect(eq(deserializedNames.at(1).front(), std::string("def")));
+        };
+
+        "multidimensional arrays"_test = [] {
+            static_assert(ArrayType<float[4][4]>);
+            static_assert(NumericRunType<float[4][4]>);
+            static_assert(NumericRunType<std::array<std::array<int16_t, 3>, 2>>);
+            static_assert(!NumericRunType<std::array<std::string, 2>>);
+            static_assert(Serializable<float[4][4]>);
+            static_assert(Serializable<std::array<std::array<int16_t, 3>, 2>>);
+
+            const float matrix[2][2] = { { 1.0f, 2.0f }, { 3.0f, 4.0f } };
+            auto        serializedMatrix = serialize(matrix);
+            expect(eq(serializedMatrix,
+                std::vector<uint8_t>{ 0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x40, 0x40, 0x00, 0x00, 0x80, 0x40 }));
+
+            float deserializedMatrix[2][2];
+            deserialize(deserializedMatrix, serializedMatrix);
+            expect(eq(deserializedMatrix[0][1], 2.0f) and eq(deserializedMatrix[1][0], 3.0f));
+
+            const float invalid[1][2] = { { 1.0f, std::nanf("") } };
+            expect(throws<std::invalid_argument>([&] { serialize(invalid); }));
+
+            const std::array<std::array<int16_t, 3>, 2> tile = { { { 1, 2, 3 }, { -1, -2, -3 } } };
+            auto serializedTile = serialize(tile);
+            expect(eq(serializedTile, std::vector<uint8_t>{ 1, 0, 2, 0, 3, 0, 0xff, 0xff, 0xfe, 0xff, 0xfd, 0xff }));
+            expect(deserialize<std::array<std::array<int16_t, 3>, 2>>(serializedTile) == tile);
+
+            std::array<Vector2D, 2> points = { { { 1, 2 }, { 3, 4 } } };
+            auto serializedPoints = serialize(points);
+            expect(eq(serializedPoints.size(), sizeof(Vector2D) * 2));
+            expect(eq(deserialize<std::array<Vector2D, 2>>(serializedPoints).at(1).y, 4));
+
+            std::array<std::array<std::string, 2>, 2> labels = { { { "a", "b" }, { "c", "d" } } };
+            auto serializedLabels = serialize(labels);
+            expect(eq(serializedLabels.size(), static_cast<size_t>(4 * 5)));
+            expect(deserialize<std::array<std::array<std::string, 2>, 2>>(serializedLabels) == labels);
+        };
+
+        "option and box"_test = [] {
+            static_assert(Serializable<std::optional<uint32_t>>);
+            static_assert(Serializable<std::unique_ptr<Vector2D>>);
+            static_assert(Serializable<arena_ptr<TreeNode>>);
+
+            std::optional<uint32_t> some = 7;
+            std::optional<uint32_t> none;
+            expect(eq(serialize(some), std::vector<uint8_t>{ 1, 7, 0, 0, 0 }));
+            expect(eq(serialize(none), std::vector<uint8_t>{ 0 }));
+
+            std::vector<uint8_t> invalidTag = { 2, 7, 0, 0, 0 };
+            expect(throws<std::invalid_argument>([&] { deserialize<std::optional<uint32_t>>(invalidTag); }));
+
+            // a Box is encoded as its pointee
+            auto point = std::make_unique<Vector2D>(Vector2D{ 1, 2 });
+            auto serializedPoint = serialize(point);
+            expect(eq(serializedPoint.size(), sizeof(Vector2D)));
+            expect(eq(deserialize<std::unique_ptr<Vector2D>>(serializedPoint)->y, 2));
+
+            std::unique_ptr<Vector2D> null;
+            expect(throws<std::invalid_argument>([&] { serialize(null); }));
+
+            Expression leaf{ "x", std::nullopt };
+            Expression negate{ "neg", std::make_shared<Expression>(leaf) };
+            auto       serializedNegate = serialize(negate);
+            expect(eq(serializedNegate, std::vector<uint8_t>{ 3, 0, 0, 0, 'n', 'e', 'g', 1, 1, 0, 0, 0, 'x', 0 }));
+            auto deserializedNegate = deserialize<Expression>(serializedNegate);
+            expect(eq((*deserializedNegate.operand)->name, std::string("x")) and !(*deserializedNegate.operand)->operand.has_value());
+        };
+
+        "deserialize into an existing object"_test = [] {
+            std::vector<Line> lines = { { { 1, 2 }, { 3, 4 }, "a rather long name that does not fit inline" }, { { 5, 6 }, { 7, 8 }, "b" } };
+            auto              serializedLines = serialize(lines);
+
+            std::vector<Line> target;
+            deserialize_into(target, serializedLines);
+            expect(eq(target.size(), static_cast<size_t>(2)) and eq(target[0].name, lines[0].name) and eq(target[1].b.y, 8));
+
+            const auto* elements = target.data();
+            const auto* name = target[0].name.data();
+            lines[0].name = "shorter name";
+            lines[0].a.x = 42;
+            auto reserialized = serialize(lines);
+            deserialize_into(target, reserialized);
+            expect(eq(target[0].name, std::string("shorter name")) and eq(target[0].a.x, 42));
+            expect(target.data() == elements and target[0].name.data() == name);
+
+            std::map<uint32_t, std::string> names = { { 1, "one" }, { 2, "two" } };
+            auto                            serializedNames = serialize(names);
+            std::map<uint32_t, std::string> targetNames = { { 7, "seven" }, { 8, "eight" }, { 9, "nine" } };
+            const auto*                     node = &*targetNames.begin();
+            deserialize_into(targetNames, serializedNames);
+            expect(static_cast<bool>(targetNames == names) and &*targetNames.begin() == node);
+
+            std::set<std::string> tags = { "x", "y" };
+            auto                  serializedTags = serialize(tags);
+            std::set<std::string> targetTags = { "z" };
+            deserialize_into(targetTags, serializedTags);
+            expect(static_cast<bool>(targetTags == tags));
+
+            std::string text = "hello";
+            auto        serializedText = serialize(text);
+            std::string targetText;
+            targetText.reserve(64);
+            const auto* characters = targetText.data();
+            deserialize_into(targetText, serializedText);
+            expect(eq(targetText, text) and targetText.data() == characters);
+        };
+
+        "consumed bytes and concatenated objects"_test = [] {
+            Line first{ { 1, 2 }, { 3, 4 }, "first" };
+            Line second{ { 5, 6 }, { 7, 8 }, "second" };
+            auto frame = serialize(first);
+            auto serializedSecond = serialize(second);
+            frame.insert(frame.end(), serializedSecond.begin(), serializedSecond.end());
+
+            Line        line;
+            std::size_t consumed = deserialize_into(line, frame);
+            expect(eq(consumed, static_cast<size_t>(16 + 4 + 5)) and eq(line.name, std::string("first")));
+            consumed += deserialize_into(line, std::span<const uint8_t>(frame).subspan(consumed));
+            expect(eq(consumed, frame.size()) and eq(line.name, std::string("second")));
+
+            std::vector<std::string> names;
+            for (const auto& item : sequence<Line>(frame))
+            {
+                names.push_back(item.name);
+            }
+            expect(names == std::vector<std::string>{ "first", "second" });
+
+            auto it = sequence<Line>(frame).begin();
+            expect(eq(it.size(), static_cast<size_t>(25)) and it.data() == frame.data());
+
+            // strict decoding has to consume everything
+            auto serializedFirst = serialize(first);
+            expect(eq(try_from_slice<Line>(serializedFirst).b.y, 4));
+            expect(throws<std::invalid_argument>([&] { try_from_slice<Line>(frame); }));
+
+            // truncated input is reported instead of read past
+            std::vector<uint8_t> truncated(frame.begin(), frame.begin() + 30);
+            std::vector<uint8_t> truncatedName(frame.begin(), frame.begin() + 22);
+            expect(throws<std::out_of_range>([&] { deserialize<Line>(truncatedName); }));
+            expect(throws<std::out_of_range>([&] {
+                for ([[maybe_unused]] const auto& item : sequence<Line>(truncated))
+                {
+                }
+            }));
+
+            std::vector<uint8_t> hugeLength = { 0xff, 0xff, 0xff, 0x7f, 1, 2 };
+            expect(throws<std::out_of_range>([&] { deserialize<std::vector<uint64_t>>(hugeLength); }));
+            expect(throws<std::out_of_range>([&] { deserialize<std::string>(hugeLength); }));
+            expect(throws<std::out_of_range>([&] { deserialize<std::vector<std::string>>(hugeLength); }));
+            expect(throws<std::out_of_range>([&] { deserialize<jagged<uint64_t>>(hugeLength); }));
+            std::vector<uint8_t> hugeRow = { 1, 0, 0, 0, 0xff, 0xff, 0xff, 0x7f, 1, 2 };
+            expect(throws<std::out_of_range>([&] { deserialize<jagged<std::string>>(hugeRow); }));
+            expect(throws<std::out_of_range>([&] { deserialize<std::unordered_map<uint32_t, uint32_t>>(hugeLength); }));
+            expect(throws<std::out_of_range>([&] { deserialize<std::unordered_set<std::string>>(hugeLength); }));
+            std::vector<uint8_t> negativeLength = { 0xff, 0xff, 0xff, 0xff };
+            expect(throws<std::invalid_argument>([&] { deserialize<std::vector<std::string>>(negativeLength); }));
+            std::vector<uint8_t> shortInteger = { 1, 2 };
+            expect(throws<std::out_of_range>([&] { deserialize<uint32_t>(shortInteger); }));
+            std::vector<uint8_t> shortString = { 5, 0, 0, 0, 'a', 'b' };
+            try
+            {
+                deserialize<std::string>(shortString);
+                expect(false);
+            }
+            catch (const incomplete_input& error)
+            {
+                expect(eq(error.needed(), static_cast<size_t>(9)));
+            }
+            expect(throws<std::out_of_range>([&] { deserialize<Celsius>(shortInteger); }));
+            auto serializedCelsius = serialize(Celsius(-1250));
+            expect(eq(deserialize<Celsius>(serializedCelsius).hundredths, -1250));
+        };
+
+        "deserialize without zeroing"_test = [] {
+            static_assert(FullyDecoded<Frame>);
+            static_assert(FullyDecoded<PriceLevel>);
+            static_assert(FullyDecoded<Tick>);
+            static_assert(FullyDecoded<std::array<std::array<int16_t, 3>, 2>>);
+            static_assert(FullyDecoded<std::vector<Line>>);
+            // a hand-written serialize() function might skip fields
+            static_assert(!FullyDecoded<Vector2D>);
+            static_assert(!FullyDecoded<Line>);
+
+            auto frame = std::make_unique<Frame>();
+            frame->sequence = 9;
+            frame->payload.fill(0xab);
+            frame->payload.back() = 0x01;
+            frame->source = "feed";
+            auto serializedFrame = serialize(frame);
+            expect(eq(serializedFrame.size(), static_cast<size_t>(4 + (1 << 16) + 4 + 4)));
+
+            auto deserializedFrame = deserialize<std::unique_ptr<Frame>>(serializedFrame);
+            expect(eq(deserializedFrame->sequence, 9u) and eq(deserializedFrame->source, std::string("feed")));
+            expect(deserializedFrame->payload == frame->payload);
+
+            auto strictFrame = try_from_slice<std::unique_ptr<Frame>>(serializedFrame);
+            expect(eq(strictFrame->payload[100], uint8_t{ 0xab }) and eq(strictFrame->payload.back(), uint8_t{ 0x01 }));
+        };
+
+        "interning"_test = [] {
+            static_assert(Serializable<interned<std::string>>);
+            static_assert(FullyDecoded<Holding>);
+
+            std::array<uint8_t, 32> alice{};
+            std::array<uint8_t, 32> bob{};
+            alice.fill(0xa1);
+            bob.fill(0xb0);
+
+            std::vector<Position> positions;
+            for (uint64_t i = 0; i < 100; ++i)
+            {
+                positions.push_back({ i % 3 == 0 ? bob : alice, i % 2 == 0 ? "SOL" : "USDC", i });
+            }
+            auto serializedPositions = serialize(positions);
+
+            // interned fields have the same wire format as the values they refer to
+            intern_pool pool;
+            auto        holdings = deserialize<std::vector<Holding>>(serializedPositions, pool);
+            expect(eq(holdings.size(), static_cast<size_t>(100)));
+            expect(eq(pool.size<std::string>(), static_cast<size_t>(2)) and eq(pool.size<std::array<uint8_t, 32>>(), static_cast<size_t>(2)));
+            expect(holdings[0].owner == bob and holdings[1].owner == alice and eq(holdings[99].amount, 99ull));
+            expect(&holdings[2].symbol.get() == &holdings[4].symbol.get() and holdings[3].symbol == std::string("USDC"));
+            expect(eq(serialize(holdings), serializedPositions));
+
+            auto known = pool.intern(std::string("SOL"));
+            expect(&known.get() == &holdings[0].symbol.get());
+
+            expect(throws<std::runtime_error>([&] { deserialize<std::vector<Holding>>(serializedPositions); }));
+
+            interned<std::string> empty;
+            expect(eq(serialize(empty), std::vector<uint8_t>{ 0, 0, 0, 0 }));
+        };
+
+        "fused fixed size fields"_test = [] {
+            static_assert(wire_size<uint16_t>() == 2);
+            static_assert(wire_size<Padded>() == 5);
+            static_assert(wire_size<Quote>() == 20);
+            static_assert(wire_size<PriceLevel>() == sizeof(PriceLevel));
+            static_assert(wire_size<std::array<Padded, 3>>() == 15);
+            static_assert(wire_size<Vector2D>() == dynamic_wire_size);
+            static_assert(wire_size<std::string>() == dynamic_wire_size);
+
+            Quote quote{ { 1, 2 }, { 3, 4 }, 2.5, 7 };
+            auto  serializedQuote = serialize(quote);
+            expect(eq(serializedQuote,
+                std::vector<uint8_t>{ 1, 2, 0, 0, 0, 3, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x04, 0x40, 7, 0 }));
+            auto deserializedQuote = deserialize<Quote>(serializedQuote);
+            expect(eq(deserializedQuote.ask.value, 4u) and eq(deserializedQuote.mid, 2.5) and eq(deserializedQuote.venue, uint16_t{ 7 }));
+
+            // a run is checked as a whole before anything is written or read
+            quote.mid = std::nan("");
+            expect(throws<std::invalid_argument>([&] { serialize(quote); }));
+            std::vector<uint8_t> truncated(serializedQuote.begin(), serializedQuote.end() - 1);
+            expect(throws<std::out_of_range>([&] { deserialize<Quote>(truncated); }));
+
+            // fixed size fields around a variable sized one form two runs
+            Transfer transfer{ { 1, 2 }, { 10, "owner", { 1, 2 }, true }, { 5, "memo" }, { 9, -1 } };
+            auto     serializedTransfer = serialize(transfer);
+            auto     deserializedTransfer = deserialize<Transfer>(serializedTransfer);
+            expect(eq(deserializedTransfer.from.owner, std::string("owner")) and eq(std::get<1>(deserializedTransfer.fee), -1l));
+            expect(eq(serialize(deserializedTransfer), serializedTransfer));
+        };
+
+        "cached encodings"_test = [] {
+            cached<Account> account(Account{ 10, "owner", { 1, 2, 3 }, false });
+            expect(eq(account.bytes(), serialize(account.get_mutable())));
+
+            // same size fields are patched in place
+            account.modify(&Account::lamports) = 20;
+            account.modify(&Account::executable) = true;
+            const auto* data = account.bytes().data();
+            auto        expected = serialize(account.get_mutable());
+            expect(eq(account.bytes(), expected) and account.bytes().data() == data);
+
+            // fields that change size are spliced in
+            account.modify(&Account::owner) = "a much longer owner";
+            account.get_mutable().data.clear();
+            account.mark_dirty(account->data);
+            account.modify(&Account::lamports) = 30;
+            expected = serialize(account.get_mutable());
+            expect(eq(account.bytes(), expected));
+
+            account.modify(&Account::owner).clear();
+            expected = serialize(account.get_mutable());
+            expect(eq(account.bytes(), expected));
+
+            // fields listed by a hand-written serialize(), parts of a field mark the whole field
+            cached<Line> line(Line{ { 1, 2 }, { 3, 4 }, "line" });
+            auto         serializedLine = serialize(line.get_mutable());
+            expect(eq(line.bytes(), serializedLine));
+            line.get_mutable().b.y = 40;
+            line.mark_dirty(line->b.y);
+            line.modify(&Line::name) = "longer line";
+            expected = serialize(line.get_mutable());
+            expect(eq(line.bytes(), expected));
+
+            int unrelated = 0;
+            expect(throws<std::invalid_argument>([&] { line.mark_dirty(unrelated); }));
+
+            auto copy = line;
+            copy.modify(&Line::name) = "copy";
+            expected = serialize(copy.get_mutable());
+            expect(eq(copy.bytes(), expected) and eq(line->name, std::string("longer line")));
+        };
+
+        "decode cache"_test = [] {
+            decode_cache<Account> cache(2);
+
+            Account alice{ 10, "alice", { 1, 2 }, false };
+            Account bob{ 20, "bob", {}, true };
+            Account carol{ 30, "carol", { 3 }, false };
+            auto    serializedAlice = serialize(alice);
+            auto    serializedBob = serialize(bob);
+            auto    serializedCarol = serialize(carol);
+
+            auto first = cache.deserialize(serializedAlice);
+            auto second = cache.deserialize(serializedAlice);
+            expect(first == second and eq(first->owner, std::string("alice")));
+            expect(eq(cache.hits(), static_cast<size_t>(1)) and eq(cache.misses(), static_cast<size_t>(1)));
+
+            // bytes that differ by one bit are a different object
+            auto changed = serializedAlice;
+            changed[0] ^= 1;
+            expect(eq(cache.deserialize(changed)->lamports, 11ull));
+
+            // alice was used least recently, so she makes way for bob
+            expect(eq(cache.deserialize(serializedBob)->owner, std::string("bob")));
+            expect(eq(cache.size(), static_cast<size_t>(2)));
+            auto again = cache.deserialize(serializedAlice);
+            expect(again != first and eq(again->lamports, 10ull) and eq(first->lamports, 10ull));
+            expect(eq(cache.deserialize(serializedCarol)->data.size(), static_cast<size_t>(1)));
+            expect(eq(cache.hits(), static_cast<size_t>(1)) and eq(cache.misses(), static_cast<size_t>(5)));
+
+            std::vector<uint8_t> truncated(serializedCarol.begin(), serializedCarol.end() - 1);
+            expect(throws<std::out_of_range>([&] { cache.deserialize(truncated); }));
+            expect(eq(cache.size(), static_cast<size_t>(2)));
+        };
+
+        "diff and apply"_test = [] {
+            Account before{ 10, "owner", std::vector<uint8_t>(1000, 7), false };
+            Account after = before;
+            after.lamports = 20;
+            after.owner = "new owner";
+            auto oldBytes = serialize(before);
+            auto newBytes = serialize(after);
+
+            const auto offsets = field_offsets<Account>(oldBytes);
+            expect(offsets == std::vector<size_t>{ 0, 8, 17, 1021, 1022 });
+
+            // only the fields that changed are shipped
+            auto changes = diff<Account>(oldBytes, newBytes);
+            expect(eq(changes.changes.size(), static_cast<size_t>(2)));
+            expect(eq(changes.changes[1].field, 1u) and eq(changes.changes[1].length, 9u));
+            auto shipped = serialize(changes);
+            expect(lt(shipped.size(), newBytes.size() / 10));
+
+            auto received = deserialize<patch>(shipped);
+            expect(eq(borsh::apply(oldBytes, received), newBytes));
+
+            Account replica = deserialize<Account>(oldBytes);
+            redecode(replica, received);
+            expect(eq(replica.lamports, 20ull) and eq(replica.owner, std::string("new owner")) and eq(replica.data.size(), static_cast<size_t>(1000)));
+            expect(eq(serialize(replica), newBytes));
+
+            expect(throws<std::invalid_argument>([&] { borsh::apply(newBytes, received); }));
+            expect(eq(diff<Account>(oldBytes, oldBytes).changes.size(), static_cast<size_t>(0)));
+            // changes that don't fit in the old bytes are rejected rather than read past them
+            patch wrapping = received;
+            wrapping.changes = { { 0, 0xfffffff0u, 0x20u, { 1, 2, 3 } } };
+            expect(throws<std::invalid_argument>([&] { borsh::apply(oldBytes, wrapping); }));
+            patch overlapping = received;
+            overlapping.changes = { received.changes[1], received.changes[0] };
+            expect(throws<std::invalid_argument>([&] { borsh::apply(oldBytes, overlapping); }));
+            patch trailing = received;
+            trailing.changes[0].bytes.push_back(0);
+            expect(throws<std::invalid_argument>([&] { redecode(replica, trailing); }));
+
+            // fields listed by a hand-written serialize()
+            Line line{ { 1, 2 }, { 3, 4 }, "line" };
+            auto oldLine = serialize(line);
+            line.a.x = 5;
+            auto newLine = serialize(line);
+            auto lineChanges = diff<Line>(oldLine, newLine);
+            expect(eq(lineChanges.changes.size(), static_cast<size_t>(1)) and eq(lineChanges.changes[0].field, 0u));
+            Line lineReplica = deserialize<Line>(oldLine);
+            redecode(lineReplica, lineChanges);
+            expect(eq(lineReplica.a.x, 5) and eq(borsh::apply(oldLine, lineChanges), newLine));
+        };
+
+        "overlay"_test = [] {
+            static_assert(FixedLayoutType<Quote>);
+            static_assert(!FixedLayoutType<Account>);
+            static_assert(field_offset_v<Quote, 2> == 10 and field_offset_v<Quote, 3> == 18);
+            static_assert(overlay<Quote>::size == 20);
+
+            Quote quote{ { 1, 2 }, { 3, 4 }, 2.5, 7 };
+            std::vector<uint8_t> record = { 0xee };
+            auto serializedQuote = serialize(quote);
+            record.insert(record.end(), serializedQuote.begin(), serializedQuote.end());
+
+            // at an odd offset, so every field is unaligned
+            overlay<Quote> view(std::span<uint8_t>(record).subspan(1));
+            expect(eq(view.get<2>(), 2.5) and eq(view.get<3>(), uint16_t{ 7 }));
+            expect(eq(view.get<1>().get<1>(), 4u));
+
+            view.set<3>(9);
+            view.get<1>().set<1>(40);
+            expect(eq(record.size(), static_cast<size_t>(21)) and eq(record[0], uint8_t{ 0xee }));
+            std::vector<uint8_t> updatedQuote(record.begin() + 1, record.end());
+            auto                 updated = deserialize<Quote>(updatedQuote);
+            expect(eq(updated.venue, uint16_t{ 9 }) and eq(updated.ask.value, 40u) and eq(updated.bid.value, 2u));
+
+            expect(throws<std::invalid_argument>([&] { view.set<2>(std::nan("")); }));
+            expect(eq(view.load().ask.tag, uint8_t{ 3 }));
+
+            PriceLevel                level{ -5, 100, 3, 1, { 0, 1, 2 } };
+            const auto                serializedLevel = serialize(level);
+            const_overlay<PriceLevel> levelView{ std::span<const uint8_t>(serializedLevel) };
+            static_assert(std::is_same_v<decltype(levelView.get<0>()), int64_t>);
+            expect(eq(levelView.get<0>(), -5l) and eq(levelView.get<1>(), 100ul) and levelView.get<4>() == level.flags);
+            std::vector<uint8_t> tooShort(10);
+            expect(throws<std::out_of_range>([&] { overlay<Quote>{ std::span<uint8_t>(tooShort) }; }));
+        };
+
+        "lazy vectors"_test = [] {
+            std::vector<Quote> quotes;
+            for (uint16_t i = 0; i < 100; ++i)
+            {
+                quotes.push_back(Quote{ { 1, i }, { 2, i }, i * 0.5, i });
+            }
+            auto            serializedQuotes = serialize(quotes);
+            lazy_vec<Quote> quoteView{ std::span<const uint8_t>(serializedQuotes) };
+            expect(eq(quoteView.size(), static_cast<size_t>(100)));
+            expect(eq(quoteView[57].venue, uint16_t{ 57 }) and eq(quoteView.at(99).ask.value, 99u));
+            expect(throws<std::out_of_range>([&] { quoteView.at(100); }));
+            serializedQuotes.pop_back();
+            expect(throws<std::out_of_range>([&] { lazy_vec<Quote>{ std::span<const uint8_t>(serializedQuotes) }; }));
+
+            std::vector<std::string> names;
+            for (int i = 0; i < 100; ++i)
+            {
+                names.push_back(std::string(static_cast<size_t>(i % 7), 'a') + std::to_string(i));
+            }
+            const auto            serializedNames = serialize(names);
+            lazy_vec<std::string> nameView{ std::span<const uint8_t>(serializedNames) };
+            expect(eq(nameView[40], names[40]) and eq(nameView[3], names[3]) and eq(nameView[99], names[99]));
+            expect(eq(nameView.front(), names[0]));
+
+            size_t index = 33;
+            for (auto it = nameView.begin_at(index); it != nameView.end(); ++it, ++index)
+            {
+                expect(eq(*it, names[index]));
+            }
+            expect(eq(index, static_cast<size_t>(100)));
+
+            std::vector<uint8_t> empty = { 0, 0, 0, 0 };
+            expect(lazy_vec<std::string>{ std::span<const uint8_t>(empty) }.empty());
+        };
+
+        "streamed vectors"_test = [] {
+            std::vector<Account> accounts;
+            for (uint64_t i = 0; i < 50; ++i)
+            {
+                accounts.push_back(Account{ i, "owner " + std::to_string(i), std::vector<uint8_t>(i * 3, 7), i % 2 == 0 });
+            }
+            auto serializedAccounts = serialize(accounts);
+
+            // reads a few bytes at a time, so that elements straddle reads and outgrow the buffer
+            const auto reader = [&serializedAccounts](size_t limit) {
+                return [&serializedAccounts, limit, position = size_t{ 0 }](uint8_t* data, size_t size) mutable {
+                    const size_t count = std::min({ size, limit, serializedAccounts.size() - position });
+                    std::memcpy(data, serializedAccounts.data() + position, count);
+                    position += count;
+                    return count;
+                };
+            };
+
+            uint64_t count = 0;
+            for (const auto& account : stream_vector<Account>(reader(5), 8))
+            {
+                expect(eq(account.lamports, count) and eq(account.owner, accounts[count].owner) and eq(account.data.size(), accounts[count].data.size()));
+                ++count;
+            }
+            expect(eq(count, 50ull));
+
+            // an element much larger than the buffer, arriving a byte at a time
+            std::vector<Account> large = { Account{ 1, "large", std::vector<uint8_t>(100000, 3), true }, accounts[2] };
+            serializedAccounts = serialize(large);
+            count = 0;
+            for (const auto& account : stream_vector<Account>(reader(1), 16))
+            {
+                expect(eq(account.data.size(), large[count].data.size()) and eq(account.owner, large[count].owner));
+                ++count;
+            }
+            expect(eq(count, 2ull));
+
+            serializedAccounts.resize(serializedAccounts.size() - 3);
+            expect(throws<incomplete_input>([&] {
+                for ([[maybe_unused]] const auto& account : stream_vector<Account>(reader(1000)))
+                {
+                }
+            }));
+
+#if __has_include(<unistd.h>)
+            std::vector<uint32_t> numbers(10000);
+            std::iota(numbers.begin(), numbers.end(), 0u);
+            const auto serializedNumbers = serialize(numbers);
+
+            int pipes[2];
+            expect(eq(pipe(pipes), 0) >> fatal);
+            std::thread writer([&] {
+                [[maybe_unused]] auto written = write(pipes[1], serializedNumbers.data(), serializedNumbers.size());
+                close(pipes[1]);
+            });
+            uint64_t sum = 0;
+            for (const auto number : stream_vector<uint32_t>(pipes[0], 4096))
+            {
+                sum += number;
+            }
+            writer.join();
+            close(pipes[0]);
+            expect(eq(sum, 49995000ull));
+#endif
+        };
+
+        "segmented input"_test = [] {
+            Transfer             transfer{ { 1, -2 }, { 500, "from", std::vector<uint8_t>(300, 9), true }, { 7, "memo" }, { 3, -40 } };
+            Quote                quote{ { 1, 2 }, { 3, 4 }, 2.5, 7 };
+            auto                 serializedTransfer = serialize(transfer);
+            auto                 serializedQuote = serialize(quote);
+            std::vector<uint8_t> bytes = serializedTransfer;
+            bytes.insert(bytes.end(), serializedQuote.begin(), serializedQuote.end());
+
+            for (const size_t segmentSize : { 1, 3, 7, 16, 1000 })
+            {
+                std::vector<std::span<const uint8_t>> segments;
+                for (size_t offset = 0; offset < bytes.size(); offset += segmentSize)
+                {
+                    segments.emplace_back(bytes.data() + offset, std::min(segmentSize, bytes.size() - offset));
+                    // empty segments are skipped over
+                    segments.emplace_back();
+                }
+
+                segmented_input input(segments);
+                auto            decodedTransfer = deserialize<Transfer>(input);
+                expect(eq(input.consumed(), serializedTransfer.size()));
+                auto decodedQuote = deserialize<Quote>(input);
+                expect(eq(input.remaining(), static_cast<size_t>(0)));
+                expect(eq(serialize(decodedTransfer), serializedTransfer) and eq(serialize(decodedQuote), serializedQuote));
+                expect(throws<std::out_of_range>([&] { deserialize<uint8_t>(input); }));
+            }
+
+            std::vector<std::span<const uint8_t>> truncated = { std::span<const uint8_t>(bytes).first(10), std::span<const uint8_t>(bytes).subspan(10, 20) };
+            segmented_input                       truncatedInput(truncated);
+            expect(throws<std::out_of_range>([&] { deserialize<Transfer>(truncatedInput); }));
+
+            // runs many segments long
+            auto samples = std::make_unique<std::array<uint16_t, 20000>>();
+            std::iota(samples->begin(), samples->end(), uint16_t{ 0 });
+            std::array<bool, 3000> mask{};
+            mask[1] = mask[2999] = true;
+            std::vector<uint8_t> runs = serialize(*samples);
+            const auto           serializedMask = serialize(mask);
+            runs.insert(runs.end(), serializedMask.begin(), serializedMask.end());
+
+            std::vector<std::span<const uint8_t>> runSegments;
+            for (size_t offset = 0; offset < runs.size(); offset += 700)
+            {
+                runSegments.emplace_back(runs.data() + offset, std::min<size_t>(700, runs.size() - offset));
+            }
+            segmented_input runInput(runSegments);
+            auto            decodedSamples = std::make_unique<std::array<uint16_t, 20000>>();
+            deserialize_into(*decodedSamples, runInput);
+            expect(*decodedSamples == *samples);
+            expect(deserialize<std::array<bool, 3000>>(runInput) == mask);
+
+            runs.back() = 2;
+            segmented_input invalidInput(runSegments);
+            deserialize_into(*decodedSamples, invalidInput);
+            expect(throws<std::invalid_argument>([&] { deserialize<std::array<bool, 3000>>(invalidInput); }));
+        };
+
+        "chunk chain output"_test = [] {
+            Transfer             transfer{ { 1, -2 }, { 500, "from", std::vector<uint8_t>(300, 9), true }, { 7, "memo" }, { 3, -40 } };
+            Quote                quote{ { 1, 2 }, { 3, 4 }, 2.5, 7 };
+            std::vector<uint8_t> expected = serialize(transfer);
+            const auto           serializedQuote = serialize(quote);
+            expected.insert(expected.end(), serializedQuote.begin(), serializedQuote.end());
+
+            chunk_chain chain(16);
+            expect(eq(serialize(transfer, chain) + serialize(quote, chain), expected.size()));
+            expect(eq(chain.size(), expected.size()) and eq(chain.flatten(), expected));
+            expect(eq(chain.segments().size(), (expected.size() + 15) / 16));
+
+            // the blocks are read back as they are
+            const auto      segments = chain.segments();
+            segmented_input input(segments);
+            auto            readBack = deserialize<Transfer>(input);
+            expect(eq(serialize(readBack), serialize(transfer)));
+
+            chain.clear();
+            std::vector<std::string> names = { "a", "bb", "ccc" };
+            serialize(names, chain);
+            std::string name = "name";
+            serialize(name, chain);
+            uint64_t number = 42;
+            serialize(number, chain);
+            auto       namesAndNumber = serialize(names);
+            const auto serializedName = serialize(name);
+            namesAndNumber.insert(namesAndNumber.end(), serializedName.begin(), serializedName.end());
+            const auto serializedNumber = serialize(number);
+            namesAndNumber.insert(namesAndNumber.end(), serializedNumber.begin(), serializedNumber.end());
+            expect(eq(chain.flatten(), namesAndNumber));
+
+#if __has_include(<unistd.h>)
+            std::FILE* file = std::tmpfile();
+            expect((file != nullptr) >> fatal);
+            expect(eq(chain.write_to(fileno(file)), namesAndNumber.size()));
+            std::rewind(file);
+            std::vector<uint8_t> written(namesAndNumber.size());
+            expect(eq(std::fread(written.data(), 1, written.size(), file), written.size()));
+            std::fclose(file);
+            expect(eq(written, namesAndNumber));
+#endif
+        };
+
+        "gather output"_test = [] {
+            Account account{ 5, std::string(10000, 'o'), std::vector<uint8_t>(100000, 3), true };
+            auto    expected = serialize(account);
+
+            gather_output output(1024);
+            expect(eq(serialize(account, output), expected.size()));
+            expect(eq(output.size(), expected.size()) and eq(output.flatten(), expected));
+
+            // lamports and the owner's length, the owner, the data's length, the data, then executable
+            const auto parts = output.segments();
+            expect(eq(parts.size(), static_cast<size_t>(5)));
+            expect(parts[1].data() == reinterpret_cast<const uint8_t*>(account.owner.data()) and parts[3].data() == account.data.data());
+            expect(eq(parts[0].size(), static_cast<size_t>(12)) and eq(parts[4].size(), static_cast<size_t>(1)));
+
+            output.clear();
+            Account small{ 1, "owner", { 1, 2, 3 }, false };
+            serialize(small, output);
+            expect(eq(output.segments().size(), static_cast<size_t>(1)) and eq(output.flatten(), serialize(small)));
+
+#if __has_include(<unistd.h>)
+            output.clear();
+            serialize(account, output);
+            std::FILE* file = std::tmpfile();
+            expect((file != nullptr) >> fatal);
+            expect(eq(output.write_to(fileno(file)), expected.size()));
+            std::rewind(file);
+            std::vector<uint8_t> written(expected.size());
+            expect(eq(std::fread(written.data(), 1, written.size(), file), written.size()));
+            std::fclose(file);
+            expect(static_cast<bool>(written == expected));
+#endif
+        };
+
+        "pooled buffers"_test = [] {
+            Account    account{ 5, "owner", std::vector<uint8_t>(5000, 3), true };
+            const auto expected = serialize(account);
+
+            buffer_pool    pool;
+            const uint8_t* first = nullptr;
+            {
+                auto buffer = serialize(account, pool);
+                expect(static_cast<bool>(*buffer == expected));
+                first = buffer.data();
+            }
+            expect(eq(pool.size(), static_cast<size_t>(1)));
+            {
+                // the warm buffer is handed out again
+                auto buffer = serialize(account, pool);
+                expect(buffer.data() == first and eq(pool.size(), static_cast<size_t>(0)));
+                std::span<const uint8_t> bytes = buffer;
+                expect(eq(bytes.size(), expected.size()));
+            }
+
+            auto big = pool.acquire(1 << 20);
+            expect(big->capacity() >= static_cast<size_t>(1 << 20) and big->empty());
+            auto kept = pool.acquire().release();
+            expect(kept.empty());
+            pooled_buffer moved = std::move(big);
+            std::span<const uint8_t> none = big;
+            expect(!big and eq(big.size(), static_cast<size_t>(0)) and big.data() == nullptr and none.empty() and big.release().empty());
+            expect(eq(pooled_buffer().size(), static_cast<size_t>(0)));
+            // too large to round up to a class, and to allocate
+            expect(throws<std::length_error>([&] { pool.acquire(SIZE_MAX); }));
+
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 4; ++i)
+            {
+                threads.emplace_back([&pool, &account, &expected] {
+                    for (int j = 0; j < 1000; ++j)
+                    {
+                        auto buffer = serialize(account, pool);
+                        if (*buffer != expected)
+                        {
+                            throw std::logic_error("Pooled buffer was shared");
+                        }
+                    }
+                });
+            }
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+            expect(pool.size() <= static_cast<size_t>(4 * buffer_pool::slots_per_class));
+
+            const auto scratch = serialize_scratch(account);
+            expect(static_cast<bool>(std::vector<uint8_t>(scratch.begin(), scratch.end()) == expected));
+            Vector2D point{ 1, 2 };
+            expect(serialize_scratch(point).data() == scratch.data() and eq(serialize_scratch(point).size(), static_cast<size_t>(8)));
+        };
+
+        "capacity hints"_test = [] {
+            capacity_hint<Account>::reset();
+            expect(eq(capacity_hint<Account>::get(), static_cast<size_t>(0)));
+
+            Account large{ 1, "owner", std::vector<uint8_t>(10000, 1), true };
+            Account small{ 1, "owner", std::vector<uint8_t>(100, 1), true };
+
+            const size_t largeSize = serialize(large).size();
+            expect(eq(capacity_hint<Account>::get(), largeSize));
+
+            // smaller encodings only wear the hint down gradually, and get the room reserved up front
+            const auto smallBytes = serialize(small);
+            expect(eq(capacity_hint<Account>::get(), largeSize - largeSize / 8));
+            expect(smallBytes.capacity() >= largeSize);
+            for (int i = 0; i < 100; ++i)
+            {
+                serialize(small);
+            }
+            expect(eq(capacity_hint<Account>::get(), smallBytes.size()));
+
+            buffer_pool pool;
+            serialize(large, pool);
+            expect(eq(capacity_hint<Account>::get(), largeSize));
+
+            Quote quote{ { 1, 2 }, { 3, 4 }, 2.5, 7 };
+            expect(eq(expected_size<Quote>(), static_cast<size_t>(20)) and eq(serialize(quote).capacity(), static_cast<size_t>(20)));
+            expect(eq(expected_size<Line>(), static_cast<size_t>(0)));
+        };
+
+        "small buffers"_test = [] {
+            Quote      quote{ { 1, 2 }, { 3, 4 }, 2.5, 7 };
+            const auto expected = serialize(quote);
+
+            auto small = serialize_small<32>(quote);
+            expect(not small.spilled() and eq(small.size(), expected.size()) and eq(small.to_vector(), expected));
+
+            Account account{ 5, "owner", std::vector<uint8_t>(100, 3), true };
+            auto    spilled = serialize_small<32>(account);
+            expect(spilled.spilled() and eq(spilled.to_vector(), serialize(account)));
+            std::span<const uint8_t> bytes = spilled;
+            expect(eq(bytes.size(), spilled.size()));
+
+            auto moved = std::move(small);
+            expect(eq(moved.to_vector(), expected) and not moved.spilled());
+            auto copied = spilled;
+            expect(eq(copied.to_vector(), spilled.to_vector()));
+
+            spilled.clear();
+            Vector2D point{ 1, 2 };
+            serialize(point, spilled);
+            expect(eq(spilled.size(), static_cast<size_t>(8)) and spilled.spilled());
+        };
+
+        "serializing into caller memory"_test = [] {
+            Account    account{ 5, "owner", std::vector<uint8_t>(100, 3), true };
+            const auto expected = serialize(account);
+
+            std::array<uint8_t, 256> slot{};
+            const auto               written = serialize_to(slot, account);
+            expect((written.has_value() and *written == expected.size()) >> fatal);
+            expect(std::equal(expected.begin(), expected.end(), slot.begin()));
+
+            std::array<uint8_t, 64> tooSmall{};
+            expect(not serialize_to(tooSmall, account).has_value());
+
+            // the output tells how much room it would have taken
+            span_output output(tooSmall);
+            serialize(account, output);
+            expect(output.overflowed() and eq(output.size(), expected.size()));
+
+            Quote quote{ { 1, 2 }, { 3, 4 }, 2.5, 7 };
+            expect(eq(serialize_to(std::span<uint8_t>(tooSmall).first(20), quote).value_or(0), static_cast<size_t>(20)));
+            expect(not serialize_to(std::span<uint8_t>(tooSmall).first(19), quote).has_value());
+            expect(throws<std::invalid_argument>([&] {
+                Quote invalid{ { 1, 2 }, { 3, 4 }, std::nan(""), 7 };
+                serialize_to(slot, invalid);
+            }));
+
+            // IsScalar types go through to_bytes()
+            const std::array<Celsius, 3> temperatures{ Celsius(-1250), Celsius(1), Celsius(2) };
+            const auto                   serializedTemperatures = serialize(temperatures);
+            expect((serialize_to(slot, temperatures).value_or(0) == serializedTemperatures.size()) >> fatal);
+            expect(std::equal(serializedTemperatures.begin(), serializedTemperatures.end(), slot.begin()));
+
+            // long double has no fixed wire size, and may have padding bytes, so it's compared after decoding
+            expect(eq(serialize_to(slot, 2.5L).value_or(0), sizeof(long double)));
+            std::vector<uint8_t> longDoubleBytes(slot.begin(), slot.begin() + sizeof(long double));
+            expect(deserialize<long double>(longDoubleBytes) == 2.5L);
+            expect(throws<std::invalid_argument>([&] { serialize_to(slot, std::nanl("")); }));
+        };
+
+        "deeply nested types"_test = [] {
+            constexpr uint32_t length = 200000;
+
+            ListNode head{ 0, std::nullopt };
+            auto*    tail = &head;
+            for (uint32_t i = 1; i < length; ++i)
+            {
+                tail->next = std::make_unique<ListNode>(ListNode{ i, std::nullopt });
+                tail = tail->next->get();
+            }
+
+            auto serializedList = serialize(head);
+            expect(eq(serializedList.size(), static_cast<size_t>(length * 5)));
+            expect(eq(serializedList[4], uint8_t{ 1 }) and eq(serializedList[5], uint8_t{ 1 }) and eq(serializedList.back(), uint8_t{ 0 }));
+
+            auto     deserializedList = deserialize<ListNode>(serializedList);
+            uint32_t count = 0;
+            bool     ordered = true;
+            for (const ListNode* node = &deserializedList; node != nullptr; node = node->next ? node->next->get() : nullptr)
+            {
+                ordered = ordered && node->value == count;
+                ++count;
+            }
+            expect(eq(count, length) and ordered);
+
+            // unlink iteratively, the recursive destructor of a list this long would overflow the stack
+            for (auto* list : { &head, &deserializedList })
+            {
+                auto next = std::move(list->next);
+                while (next)
+                {
+                    next = std::move((*next)->next);
+                }
+            }
+
+            // a right-leaning tree goes down its tail pointers, its nodes come from an arena
+            arena    nodes;
+            TreeNode root{ 0, std::nullopt, std::nullopt };
+            auto*    rightmost = &root;
+            for (int64_t key = 1; key < 1000; ++key)
+            {
+                void* memory = nodes.allocate(sizeof(TreeNode), alignof(TreeNode));
+                rightmost->right = arena_ptr<TreeNode>(new (memory) TreeNode{ key, std::nullopt, std::nullopt });
+                if (key % 10 == 0)
+                {
+                    void* leaf = nodes.allocate(sizeof(TreeNode), alignof(TreeNode));
+                    rightmost->left = arena_ptr<TreeNode>(new (leaf) TreeNode{ -key, std::nullopt, std::nullopt });
+                }
+                rightmost = rightmost->right->get();
+            }
+
+            auto serializedTree = serialize(root);
+            expect(throws<std::runtime_error>([&] { deserialize<TreeNode>(serializedTree); }));
+
+            arena decodeArena;
+            auto  deserializedTree = deserialize<TreeNode>(serializedTree, decodeArena);
+            expect(eq(serialize(deserializedTree), serializedTree));
+            expect(eq((*(*deserializedTree.right)->right)->key, 2ll));
+            expect(eq((*(*(*deserializedTree.right)->right)->right)->key, 3ll));
+
+            // a left-leaning tree puts off the right pointer of every node while it goes down the left one
+            constexpr int64_t depth = 1000000;
+            arena             leftNodes;
+            TreeNode          leftRoot{ 0, std::nullopt, std::nullopt };
+            auto*             leftmost = &leftRoot;
+            for (int64_t key = 1; key < depth; ++key)
+            {
+                void* memory = leftNodes.allocate(sizeof(TreeNode), alignof(TreeNode));
+                leftmost->left = arena_ptr<TreeNode>(new (memory) TreeNode{ key, std::nullopt, std::nullopt });
+                leftmost = leftmost->left->get();
+                if (key % 1000 == 0)
+                {
+                    void* leaf = leftNodes.allocate(sizeof(TreeNode), alignof(TreeNode));
+                    leftmost->right = arena_ptr<TreeNode>(new (leaf) TreeNode{ -key, std::nullopt, std::nullopt });
+                }
+            }
+
+            // every node is a key and two option tags
+            auto serializedLeftTree = serialize(leftRoot);
+            expect(eq(serializedLeftTree.size(), static_cast<size_t>(depth + depth / 1000 - 1) * 10));
+
+            arena leftDecodeArena;
+            auto  deserializedLeftTree = deserialize<TreeNode>(serializedLeftTree, leftDecodeArena);
+            expect(eq(serialize(deserializedLeftTree), serializedLeftTree));
+            int64_t nodeCount = 0;
+            bool    leftOrdered = true;
+            for (const TreeNode* node = &deserializedLeftTree; node != nullptr; node = node->left ? node->left->get() : nullptr)
+            {
+                const bool hasLeaf = nodeCount % 1000 == 0 && nodeCount != 0;
+                leftOrdered = leftOrdered && node->key == nodeCount && node->right.has_value() == hasLeaf
+                    && (!hasLeaf || (*node->right)->key == -nodeCount);
+                ++nodeCount;
+            }
+            expect(eq(nodeCount, depth) and leftOrdered);
+
+            for (auto* tree : { &leftRoot, &deserializedLeftTree })
+            {
+                auto next = std::move(tree->left);
+                while (next)
+                {
+                    next = std::move((*next)->left);
+                }
+            }
+
+            // so does a vector of children for the ones after the first
+            Branch trunk{ 0, {} };
+            auto*  top = &trunk;
+            for (uint32_t value = 1; value < 100000; ++value)
+            {
+                top->children.push_back(std::make_unique<Branch>(Branch{ value, {} }));
+                if (value % 100 == 0)
+                {
+                    top->children.push_back(std::make_unique<Branch>(Branch{ value + 1000000, {} }));
+                }
+                top = top->children.front().get();
+            }
+
+            auto serializedTrunk = serialize(trunk);
+            auto deserializedTrunk = deserialize<Branch>(serializedTrunk);
+            expect(eq(serialize(deserializedTrunk), serializedTrunk));
+            expect(eq(deserializedTrunk.children.front()->children.front()->value, 2u));
+
+            for (auto* branch : { &trunk, &deserializedTrunk })
+            {
+                auto next = std::move(branch->children);
+                while (!next.empty())
+                {
+                    auto children = std::move(next.front()->children);
+                    next = std::move(children);
+                }
+            }
+
+            // a Box that something after it can't wait for, like the next element of a fixed size array, is visited
+            // recursively, up to a limit
+            const auto forks = [](size_t forkDepth) {
+                Fork  forkRoot;
+                Fork* innermost = &forkRoot;
+                for (size_t i = 0; i < forkDepth; ++i)
+                {
+                    innermost->branches[0] = std::make_unique<Fork>();
+                    innermost = innermost->branches[0]->get();
+                }
+                return forkRoot;
+            };
+            auto shallowForks = forks(100);
+            auto serializedForks = serialize(shallowForks);
+            auto deserializedForks = deserialize<Fork>(serializedForks);
+            expect(eq(serialize(deserializedForks), serializedForks));
+            auto deepForks = forks(2000);
+            expect(throws<std::runtime_error>([&] { serialize(deepForks); }));
+        };
     };
 }